@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <time.h>
 
 #include <wiringPi.h>
 
@@ -44,30 +45,140 @@
 #define	RTC_TC		 8
 #define	RTC_BM		31
 
+#define	RAM_SIZE	31
+
+// Each half clock cycle, in nS. The chip's slowest (at 2V) is 1uS
+//	high and 1uS low, so 500KHz.
+
+#define	DS_HALF_NS	1000
+
 
 // Locals
+//	One of these for each chip. The original calls without a handle use
+//	the one set up last with ds1302setup.
+//	On-board clock and data pins are resolved to their GPIO registers
+//	at setup time so each bit isn't a trip through digitalWrite.
+
+struct ds1302Struct
+{
+  int dPin, cPin, sPin ;
+  int fastC, fastD ;
+  unsigned int half ;		// Spins for DS_HALF_NS
+  struct wpiPinRegs c, d ;
+} ;
+
+static struct ds1302Struct ds1302s [MAX_DS1302] ;
+static int numDs1302 = 0 ;
+static int defaultDs = 0 ;
+
+
+/*
+ * dsClock: dsData: dsRead:
+ *	Drive the clock and data lines, or read the data line - straight
+ *	through the GPIO registers when we can.
+ *********************************************************************************
+ */
+
+static void dsClock (const struct ds1302Struct *ds, int value)
+{
+  /**/ if (!ds->fastC)
+    digitalWrite (ds->cPin, value) ;
+  else if (value)
+    *ds->c.set = ds->c.mask ;
+  else
+    *ds->c.clr = ds->c.mask ;
+}
+
+static void dsData (const struct ds1302Struct *ds, int value)
+{
+  /**/ if (!ds->fastD)
+    digitalWrite (ds->dPin, value) ;
+  else if (value)
+    *ds->d.set = ds->d.mask ;
+  else
+    *ds->d.clr = ds->d.mask ;
+}
+
+static int dsRead (const struct ds1302Struct *ds)
+{
+  if (ds->fastD)
+    return (*ds->d.lev & ds->d.mask) != 0 ;
+  else
+    return digitalRead (ds->dPin) ;
+}
+
+
+/*
+ * dsSpin: dsCalibrate: dsWait:
+ *	Wait half a clock cycle. delayMicroseconds is a gettimeofday ()
+ *	spin that's good for 1-2uS at best, so when we're driving the
+ *	registers ourselves we pace the edges with a busy loop, timed
+ *	against the system clock the once.
+ *********************************************************************************
+ */
+
+static unsigned int spinsPerMs = 0 ;
+
+static void dsSpin (unsigned int count)
+{
+  volatile unsigned int i ;
+
+  for (i = 0 ; i < count ; ++i)
+    ;
+}
+
+static void dsCalibrate (void)
+{
+  struct timespec start, end ;
+  unsigned int count = 100000, best = 0, perMs ;
+  long long ns ;
+  int tries ;
+
+  for (tries = 0 ; tries < 5 ; ++tries)		// Best of a few, in case we get scheduled out
+  {
+    clock_gettime (CLOCK_MONOTONIC, &start) ;
+    dsSpin (count) ;
+    clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+    ns = (long long)(end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec) ;
+    if (ns <= 0)
+      ns = 1 ;
+
+    perMs = (unsigned int)((long long)count * 1000000LL / ns) ;
+    if (perMs > best)
+      best = perMs ;
+  }
+
+  spinsPerMs = (best == 0) ? 1 : best ;
+}
+
+static void dsWait (const struct ds1302Struct *ds)
+{
+  if (ds->fastC)
+    dsSpin (ds->half) ;
+  else
+    delayMicroseconds (1) ;
+}
 
-static int dPin, cPin, sPin ;
 
 /*
  * dsShiftIn:
- *	Shift a number in from the chip, LSB first. Note that the data is
- *	sampled on the trailing edge of the last clock, so it's valid immediately.
+ *	Shift a number in from the chip, LSB first. Each bit is driven out
+ *	on the falling edge of the previous clock, and the half cycle we
+ *	then wait with the clock low covers the chip's clock-to-data delay.
  *********************************************************************************
  */
 
-static unsigned int dsShiftIn (void)
+static unsigned int dsShiftIn (const struct ds1302Struct *ds)
 {
   uint8_t value = 0 ;
   int i ;
 
-  pinMode (dPin, INPUT) ;	delayMicroseconds (1) ;
-
   for (i = 0 ; i < 8 ; ++i)
   {
-    value |= (digitalRead (dPin) << i) ;
-    digitalWrite (cPin, HIGH) ; delayMicroseconds (1) ;
-    digitalWrite (cPin, LOW) ;	delayMicroseconds (1) ;
+    value |= (dsRead (ds) << i) ;
+    dsClock (ds, HIGH) ; dsWait (ds) ;
+    dsClock (ds, LOW) ;  dsWait (ds) ;
   }
 
   return value;
@@ -77,49 +188,57 @@ static unsigned int dsShiftIn (void)
 /*
  * dsShiftOut:
  *	A normal LSB-first shift-out, just slowed down a bit - the Pi is
- *	a bit faster than the chip can handle.
+ *	a bit faster than the chip can handle. The chip latches the data on
+ *	the rising clock edge and wants it there for a while before that, so
+ *	each bit is set up straight after the falling edge and the clock's
+ *	low half cycle covers it.
  *********************************************************************************
  */
 
-static void dsShiftOut (unsigned int data)
+static void dsShiftOut (const struct ds1302Struct *ds, unsigned int data)
 {
   int i ;
 
-  pinMode (dPin, OUTPUT) ;
-
   for (i = 0 ; i < 8 ; ++i)
   {
-    digitalWrite (dPin, data & (1 << i)) ;	delayMicroseconds (1) ;
-    digitalWrite (cPin, HIGH) ;			delayMicroseconds (1) ;
-    digitalWrite (cPin, LOW) ;			delayMicroseconds (1) ;
+    dsData  (ds, data & (1 << i)) ; dsWait (ds) ;
+    dsClock (ds, HIGH) ;            dsWait (ds) ;
+    dsClock (ds, LOW) ;
   }
 }
 
 
 /*
- * ds1302regRead: ds1302regWrite:
- *	Read/Write a value to an RTC Register or RAM location on the chip
+ * dsTransfer:
+ *	A complete transaction: send the command, then write len bytes, or
+ *	read them back if it's a read command (bit 0 set), all in the one
+ *	chip-select.
  *********************************************************************************
  */
 
-static unsigned int ds1302regRead (const int reg)
+static void dsTransfer (const struct ds1302Struct *ds, const unsigned int command, unsigned char *data, const int len)
 {
-  unsigned int data ;
+  int i ;
 
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
-    dsShiftOut (reg) ;
-    data = dsShiftIn () ;
-  digitalWrite (sPin, LOW)  ; delayMicroseconds (1) ;
+  pinMode      (ds->dPin, OUTPUT) ;
+  digitalWrite (ds->sPin, HIGH) ; delayMicroseconds (1) ;
 
-  return data ;
-}
+  dsShiftOut (ds, command) ;
 
-static void ds1302regWrite (const int reg, const unsigned int data)
-{
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
-    dsShiftOut (reg) ;
-    dsShiftOut (data) ;
-  digitalWrite (sPin, LOW)  ; delayMicroseconds (1) ;
+  if ((command & 1) != 0)
+  {
+    pinMode (ds->dPin, INPUT) ; delayMicroseconds (1) ;
+    for (i = 0 ; i < len ; ++i)
+      data [i] = dsShiftIn (ds) ;
+  }
+  else
+  {
+    for (i = 0 ; i < len ; ++i)
+      dsShiftOut (ds, data [i]) ;
+    dsWait (ds) ;				// Hold after the last clock
+  }
+
+  digitalWrite (ds->sPin, LOW)  ; delayMicroseconds (1) ;
 }
 
 
@@ -129,14 +248,29 @@ static void ds1302regWrite (const int reg, const unsigned int data)
  *********************************************************************************
  */
 
+unsigned int ds1302rtcReadDev (const int fd, const int reg)
+{
+  unsigned char data ;
+
+  dsTransfer (&ds1302s [fd], 0x81 | ((reg & 0x1F) << 1), &data, 1) ;
+  return data ;
+}
+
+void ds1302rtcWriteDev (const int fd, const int reg, const unsigned int data)
+{
+  unsigned char byte = data ;
+
+  dsTransfer (&ds1302s [fd], 0x80 | ((reg & 0x1F) << 1), &byte, 1) ;
+}
+
 unsigned int ds1302rtcRead (const int reg)
 {
-  return ds1302regRead (0x81 | ((reg & 0x1F) << 1)) ;
+  return ds1302rtcReadDev (defaultDs, reg) ;
 }
 
-void ds1302rtcWrite (int reg, unsigned int data)
+void ds1302rtcWrite (const int reg, const unsigned int data)
 {
-  ds1302regWrite (0x80 | ((reg & 0x1F) << 1), data) ;
+  ds1302rtcWriteDev (defaultDs, reg, data) ;
 }
 
 
@@ -146,34 +280,85 @@ void ds1302rtcWrite (int reg, unsigned int data)
  *********************************************************************************
  */
 
+unsigned int ds1302ramReadDev (const int fd, const int addr)
+{
+  unsigned char data ;
+
+  dsTransfer (&ds1302s [fd], 0xC1 | ((addr & 0x1F) << 1), &data, 1) ;
+  return data ;
+}
+
+void ds1302ramWriteDev (const int fd, const int addr, const unsigned int data)
+{
+  unsigned char byte = data ;
+
+  dsTransfer (&ds1302s [fd], 0xC0 | ((addr & 0x1F) << 1), &byte, 1) ;
+}
+
 unsigned int ds1302ramRead (const int addr)
 {
-  return ds1302regRead (0xC1 | ((addr & 0x1F) << 1)) ;
+  return ds1302ramReadDev (defaultDs, addr) ;
 }
 
 void ds1302ramWrite (const int addr, const unsigned int data)
 {
-  ds1302regWrite ( 0xC0 | ((addr & 0x1F) << 1), data) ;
+  ds1302ramWriteDev (defaultDs, addr, data) ;
+}
+
+
+/*
+ * ds1302ramBurstRead: ds1302ramBurstWrite:
+ *	Read/Write all 31 bytes of the RAM in a single operation
+ *********************************************************************************
+ */
+
+void ds1302ramBurstReadDev (const int fd, unsigned char ramData [31])
+{
+  dsTransfer (&ds1302s [fd], 0xC1 | ((RTC_BM & 0x1F) << 1), ramData, RAM_SIZE) ;
+}
+
+void ds1302ramBurstWriteDev (const int fd, const unsigned char ramData [31])
+{
+  unsigned char data [RAM_SIZE] ;
+  int i ;
+
+  for (i = 0 ; i < RAM_SIZE ; ++i)
+    data [i] = ramData [i] ;
+
+  dsTransfer (&ds1302s [fd], 0xC0 | ((RTC_BM & 0x1F) << 1), data, RAM_SIZE) ;
 }
 
+void ds1302ramBurstRead (unsigned char ramData [31])
+{
+  ds1302ramBurstReadDev (defaultDs, ramData) ;
+}
+
+void ds1302ramBurstWrite (const unsigned char ramData [31])
+{
+  ds1302ramBurstWriteDev (defaultDs, ramData) ;
+}
+
+
 /*
  * ds1302clockRead:
  *	Read all 8 bytes of the clock in a single operation
  *********************************************************************************
  */
 
-void ds1302clockRead (int clockData [8])
+void ds1302clockReadDev (const int fd, int clockData [8])
 {
+  unsigned char data [8] ;
   int i ;
-  unsigned int regVal = 0x81 | ((RTC_BM & 0x1F) << 1) ;
 
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
+  dsTransfer (&ds1302s [fd], 0x81 | ((RTC_BM & 0x1F) << 1), data, 8) ;
 
-  dsShiftOut (regVal) ;
   for (i = 0 ; i < 8 ; ++i)
-    clockData [i] = dsShiftIn () ;
+    clockData [i] = data [i] ;
+}
 
-  digitalWrite (sPin, LOW) ;  delayMicroseconds (1) ;
+void ds1302clockRead (int clockData [8])
+{
+  ds1302clockReadDev (defaultDs, clockData) ;
 }
 
 
@@ -183,18 +368,20 @@ void ds1302clockRead (int clockData [8])
  *********************************************************************************
  */
 
-void ds1302clockWrite (const int clockData [8])
+void ds1302clockWriteDev (const int fd, const int clockData [8])
 {
+  unsigned char data [8] ;
   int i ;
-  unsigned int regVal = 0x80 | ((RTC_BM & 0x1F) << 1) ;
-
-  digitalWrite (sPin, HIGH) ; delayMicroseconds (1) ;
 
-  dsShiftOut (regVal) ;
   for (i = 0 ; i < 8 ; ++i)
-    dsShiftOut (clockData [i]) ;
+    data [i] = clockData [i] ;
 
-  digitalWrite (sPin, LOW) ;  delayMicroseconds (1) ;
+  dsTransfer (&ds1302s [fd], 0x80 | ((RTC_BM & 0x1F) << 1), data, 8) ;
+}
+
+void ds1302clockWrite (const int clockData [8])
+{
+  ds1302clockWriteDev (defaultDs, clockData) ;
 }
 
 
@@ -205,17 +392,77 @@ void ds1302clockWrite (const int clockData [8])
  *********************************************************************************
  */
 
-void ds1302trickleCharge (const int diodes, const int resistors)
+void ds1302trickleChargeDev (const int fd, const int diodes, const int resistors)
 {
   if (diodes + resistors == 0)
-    ds1302rtcWrite (RTC_TC, 0x5C) ;	// Disabled
+    ds1302rtcWriteDev (fd, RTC_TC, 0x5C) ;	// Disabled
   else
-    ds1302rtcWrite (RTC_TC, 0xA0 | ((diodes & 3) << 2) | (resistors & 3)) ;
+    ds1302rtcWriteDev (fd, RTC_TC, 0xA0 | ((diodes & 3) << 2) | (resistors & 3)) ;
+}
+
+void ds1302trickleCharge (const int diodes, const int resistors)
+{
+  ds1302trickleChargeDev (defaultDs, diodes, resistors) ;
 }
 
 
 
 
+/*
+ * ds1302setupDev:
+ *	Initialise a chip & remember the pins it's on. Returns a handle for
+ *	the ...Dev functions, or -1 if we've no room for any more.
+ *********************************************************************************
+ */
+
+int ds1302setupDev (const int clockPin, const int dataPin, const int csPin)
+{
+  struct ds1302Struct *ds ;
+  int fd ;
+
+// Same pins as one we already know about?
+
+  for (fd = 0 ; fd < numDs1302 ; ++fd)
+    if ((ds1302s [fd].cPin == clockPin) && (ds1302s [fd].dPin == dataPin) && (ds1302s [fd].sPin == csPin))
+      break ;
+
+  if (fd == numDs1302)
+  {
+    if (numDs1302 == MAX_DS1302)
+      return -1 ;
+    ++numDs1302 ;
+  }
+
+  ds = &ds1302s [fd] ;
+
+  ds->dPin = dataPin ;
+  ds->cPin = clockPin ;
+  ds->sPin = csPin ;
+
+  ds->fastC = wiringPiPinRegs (clockPin, &ds->c) ;
+  ds->fastD = wiringPiPinRegs (dataPin,  &ds->d) ;
+
+  if (ds->fastC)
+  {
+    if (spinsPerMs == 0)
+      dsCalibrate () ;
+    ds->half = (unsigned int)((unsigned long long)spinsPerMs * DS_HALF_NS / 1000000) + 1 ;
+  }
+
+  digitalWrite (ds->dPin, LOW) ;
+  digitalWrite (ds->cPin, LOW) ;
+  digitalWrite (ds->sPin, LOW) ;
+
+  pinMode (ds->dPin, OUTPUT) ;
+  pinMode (ds->cPin, OUTPUT) ;
+  pinMode (ds->sPin, OUTPUT) ;
+
+  ds1302rtcWriteDev (fd, RTC_WP, 0) ;	// Remove write-protect
+
+  return fd ;
+}
+
+
 /*
  * ds1302setup:
  *	Initialise the chip & remember the pins we're using
@@ -224,17 +471,8 @@ void ds1302trickleCharge (const int diodes, const int resistors)
 
 void ds1302setup (const int clockPin, const int dataPin, const int csPin)
 {
-  dPin = dataPin ;
-  cPin = clockPin ;
-  sPin = csPin ;
-
-  digitalWrite (dPin, LOW) ;
-  digitalWrite (cPin, LOW) ;
-  digitalWrite (sPin, LOW) ;
-
-  pinMode (dPin, OUTPUT) ;
-  pinMode (cPin, OUTPUT) ;
-  pinMode (sPin, OUTPUT) ;
+  int fd ;
 
-  ds1302rtcWrite (RTC_WP, 0) ;	// Remove write-protect
+  if ((fd = ds1302setupDev (clockPin, dataPin, csPin)) >= 0)
+    defaultDs = fd ;
 }
@@ -22,6 +22,8 @@
  ***********************************************************************
  */
 
+#define	MAX_DS1302	4
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +33,8 @@ extern void         ds1302rtcWrite      (const int reg, const unsigned int data)
 
 extern unsigned int ds1302ramRead       (const int addr) ;
 extern void         ds1302ramWrite      (const int addr, const unsigned int data) ;
+extern void         ds1302ramBurstRead  (unsigned char ramData [31]) ;
+extern void         ds1302ramBurstWrite (const unsigned char ramData [31]) ;
 
 extern void         ds1302clockRead     (int clockData [8]) ;
 extern void         ds1302clockWrite    (const int clockData [8]) ;
@@ -39,6 +43,23 @@ extern void         ds1302trickleCharge (const int diodes, const int resistors)
 
 extern void         ds1302setup         (const int clockPin, const int dataPin, const int csPin) ;
 
+// With a handle from ds1302setupDev, for more than one chip
+
+extern unsigned int ds1302rtcReadDev       (const int fd, const int reg) ;
+extern void         ds1302rtcWriteDev      (const int fd, const int reg, const unsigned int data) ;
+
+extern unsigned int ds1302ramReadDev       (const int fd, const int addr) ;
+extern void         ds1302ramWriteDev      (const int fd, const int addr, const unsigned int data) ;
+extern void         ds1302ramBurstReadDev  (const int fd, unsigned char ramData [31]) ;
+extern void         ds1302ramBurstWriteDev (const int fd, const unsigned char ramData [31]) ;
+
+extern void         ds1302clockReadDev     (const int fd, int clockData [8]) ;
+extern void         ds1302clockWriteDev    (const int fd, const int clockData [8]) ;
+
+extern void         ds1302trickleChargeDev (const int fd, const int diodes, const int resistors) ;
+
+extern int          ds1302setupDev         (const int clockPin, const int dataPin, const int csPin) ;
+
 #ifdef __cplusplus
 }
 #endif
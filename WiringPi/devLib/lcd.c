@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 
 #include <wiringPi.h>
@@ -70,9 +71,14 @@
 struct lcdDataStruct
 {
   int bits, rows, cols ;
-  int rsPin, strbPin ;
+  int rsPin, strbPin, rwPin ;
   int dataPins [8] ;
+  int busPins  [9] ;		// Data pins then RS - written in one go
   int cx, cy ;
+  int addrValid ;		// The display's address matches cx, cy
+
+  unsigned char *shadow ;	// What's on the display, rows x cols
+  int shadowValid ;
 } ;
 
 struct lcdDataStruct *lcds [MAX_LCDS] ;
@@ -87,57 +93,86 @@ static const int rowOff [4] = { 0x00, 0x40, 0x14, 0x54 } ;
 /*
  * strobe:
  *	Toggle the strobe (Really the "E") pin to the device.
- *	According to the docs, data is latched on the falling edge.
+ *	According to the docs, data is latched on the falling edge and the
+ *	pulse only needs to be 450nS wide, so we don't hang around here -
+ *	waiting for the display to finish is done after the whole byte.
  *********************************************************************************
  */
 
 static void strobe (const struct lcdDataStruct *lcd)
 {
+  digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+  digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+}
+
+
+/*
+ * waitBusy:
+ *	If we have the RW pin then we can ask the display when it's ready
+ *	rather than wait for the worst case. The display drives the data
+ *	pins while we read, so make sure it's safe for your Pi to see them
+ *	(e.g. a 3.3v display, or level shifters) before using this.
+ *********************************************************************************
+ */
+
+static void waitBusy (const struct lcdDataStruct *lcd)
+{
+  int i, busy, tries ;
+
+  for (i = 0 ; i < lcd->bits ; ++i)
+    pinMode (lcd->dataPins [i], INPUT) ;
+
+  digitalWrite (lcd->rsPin, 0) ;
+  digitalWrite (lcd->rwPin, 1) ;
+
+  for (tries = 0 ; tries < 1000 ; ++tries)	// Few mS - longer than a clear
+  {
+    digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+    busy = digitalRead (lcd->dataPins [lcd->bits - 1]) ;
+    digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+
+    if (lcd->bits == 4)				// Clock out the low nibble too
+      strobe (lcd) ;
+
+    if (busy == LOW)
+      break ;
+  }
 
-// Note timing changes for new version of delayMicroseconds ()
+  digitalWrite (lcd->rwPin, 0) ;
 
-  digitalWrite (lcd->strbPin, 1) ; delayMicroseconds (50) ;
-  digitalWrite (lcd->strbPin, 0) ; delayMicroseconds (50) ;
+  for (i = 0 ; i < lcd->bits ; ++i)
+    pinMode (lcd->dataPins [i], OUTPUT) ;
 }
 
 
 /*
  * sentDataCmd:
- *	Send an data or command byte to the display.
+ *	Send an data or command byte to the display. RS and the data pins
+ *	are set together with a single write - on-board pins all change at
+ *	once and pins on an expander take one bus transaction.
  *********************************************************************************
  */
 
-static void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data)
+static void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data, int rs)
 {
-  register unsigned char myData = data ;
-  unsigned char          i, d4 ;
+  if (lcd->rwPin != -1)
+    waitBusy (lcd) ;
+
+  rs = (rs != 0) ;
 
   if (lcd->bits == 4)
   {
-    d4 = (myData >> 4) & 0x0F;
-    for (i = 0 ; i < 4 ; ++i)
-    {
-      digitalWrite (lcd->dataPins [i], (d4 & 1)) ;
-      d4 >>= 1 ;
-    }
+    digitalWriteMany (lcd->busPins, 5, (rs << 4) | (data >> 4)) ;
     strobe (lcd) ;
-
-    d4 = myData & 0x0F ;
-    for (i = 0 ; i < 4 ; ++i)
-    {
-      digitalWrite (lcd->dataPins [i], (d4 & 1)) ;
-      d4 >>= 1 ;
-    }
+    digitalWriteMany (lcd->busPins, 5, (rs << 4) | (data & 0x0F)) ;
   }
   else
-  {
-    for (i = 0 ; i < 8 ; ++i)
-    {
-      digitalWrite (lcd->dataPins [i], (myData & 1)) ;
-      myData >>= 1 ;
-    }
-  }
+    digitalWriteMany (lcd->busPins, 9, (rs << 8) | data) ;
+
   strobe (lcd) ;
+
+  if (lcd->rwPin == -1)		// Most instructions take 37uS
+    delayMicroseconds (50) ;
 }
 
 
@@ -149,24 +184,45 @@ static void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data)
 
 static void putCommand (const struct lcdDataStruct *lcd, unsigned char command)
 {
-  digitalWrite (lcd->rsPin,   0) ;
-  sendDataCmd  (lcd, command) ;
-  delay (2) ;
+  sendDataCmd (lcd, command, 0) ;
+
+  if ((lcd->rwPin == -1) && (command <= LCD_HOME))	// Clear and Home take 1.52mS
+    delay (2) ;
 }
 
 static void put4Command (const struct lcdDataStruct *lcd, unsigned char command)
 {
-  register unsigned char myCommand = command ;
-  register unsigned char i ;
+  digitalWriteMany (lcd->busPins, 5, command & 0x0F) ;
+  strobe (lcd) ;
+}
 
-  digitalWrite (lcd->rsPin,   0) ;
 
-  for (i = 0 ; i < 4 ; ++i)
-  {
-    digitalWrite (lcd->dataPins [i], (myCommand & 1)) ;
-    myCommand >>= 1 ;
-  }
-  strobe (lcd) ;
+/*
+ * setAddress:
+ *	Point the display at the cursor position if it isn't already
+ *********************************************************************************
+ */
+
+static void setAddress (struct lcdDataStruct *lcd)
+{
+  if (lcd->addrValid)
+    return ;
+
+  putCommand (lcd, lcd->cx + (LCD_DGRAM | rowOff [lcd->cy])) ;
+  lcd->addrValid = TRUE ;
+}
+
+
+/*
+ * cursorShown:
+ *	With the cursor visible we can't be lazy about where the display's
+ *	address is as it's what the user sees.
+ *********************************************************************************
+ */
+
+static int cursorShown (void)
+{
+  return (lcdControl & (LCD_CURSOR_CTRL | LCD_BLINK_CTRL)) != 0 ;
 }
 
 
@@ -188,7 +244,9 @@ void lcdHome (const int fd)
 
   putCommand (lcd, LCD_HOME) ;
   lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
+  lcd->addrValid = TRUE ;
+  if (lcd->rwPin == -1)
+    delay (5) ;
 }
 
 void lcdClear (const int fd)
@@ -198,7 +256,12 @@ void lcdClear (const int fd)
   putCommand (lcd, LCD_CLEAR) ;
   putCommand (lcd, LCD_HOME) ;
   lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
+  lcd->addrValid = TRUE ;
+  if (lcd->rwPin == -1)
+    delay (5) ;
+
+  memset (lcd->shadow, ' ', lcd->rows * lcd->cols) ;
+  lcd->shadowValid = TRUE ;
 }
 
 
@@ -255,6 +318,11 @@ void lcdSendCommand (const int fd, unsigned char command)
 {
   struct lcdDataStruct *lcd = lcds [fd] ;
   putCommand (lcd, command) ;
+
+// We've no idea what it did, so don't trust our copy of the display
+
+  lcd->addrValid   = FALSE ;
+  lcd->shadowValid = FALSE ;
 }
 
 
@@ -269,15 +337,17 @@ void lcdPosition (const int fd, int x, int y)
 {
   struct lcdDataStruct *lcd = lcds [fd] ;
 
-  if ((x > lcd->cols) || (x < 0))
+  if ((x >= lcd->cols) || (x < 0))
     return ;
-  if ((y > lcd->rows) || (y < 0))
+  if ((y >= lcd->rows) || (y < 0))
     return ;
 
-  putCommand (lcd, x + (LCD_DGRAM | rowOff [y])) ;
-
   lcd->cx = x ;
   lcd->cy = y ;
+  lcd->addrValid = FALSE ;
+
+  if (cursorShown ())
+    setAddress (lcd) ;
 }
 
 
@@ -294,9 +364,10 @@ void lcdCharDef (const int fd, int index, unsigned char data [8])
 
   putCommand (lcd, LCD_CGRAM | ((index & 7) << 3)) ;
 
-  digitalWrite (lcd->rsPin, 1) ;
   for (i = 0 ; i < 8 ; ++i)
-    sendDataCmd (lcd, data [i]) ;
+    sendDataCmd (lcd, data [i], 1) ;
+
+  lcd->addrValid = FALSE ;	// Pointing into CGRAM now
 }
 
 
@@ -304,24 +375,36 @@ void lcdCharDef (const int fd, int index, unsigned char data [8])
  * lcdPutchar:
  *	Send a data byte to be displayed on the display. We implement a very
  *	simple terminal here - with line wrapping, but no scrolling. Yet.
+ *	We keep a copy of what's on the display, so a character that's
+ *	already there isn't sent again - we just move past it.
  *********************************************************************************
  */
 
 void lcdPutchar (const int fd, unsigned char data)
 {
   struct lcdDataStruct *lcd = lcds [fd] ;
+  unsigned char *shadow = &lcd->shadow [lcd->cy * lcd->cols + lcd->cx] ;
 
-  digitalWrite (lcd->rsPin, 1) ;
-  sendDataCmd  (lcd, data) ;
+  if (lcd->shadowValid && (*shadow == data))
+    lcd->addrValid = FALSE ;
+  else
+  {
+    setAddress  (lcd) ;
+    sendDataCmd (lcd, data, 1) ;
+    *shadow = data ;
+  }
 
   if (++lcd->cx == lcd->cols)
   {
     lcd->cx = 0 ;
     if (++lcd->cy == lcd->rows)
       lcd->cy = 0 ;
-    
-    putCommand (lcd, lcd->cx + (LCD_DGRAM | rowOff [lcd->cy])) ;
+
+    lcd->addrValid = FALSE ;
   }
+
+  if (cursorShown ())
+    setAddress (lcd) ;
 }
 
 
@@ -338,6 +421,67 @@ void lcdPuts (const int fd, const char *string)
 }
 
 
+/*
+ * lcdUpdate:
+ *	Make the whole display look like fullScreen - rows x cols characters,
+ *	row by row (padded out with spaces if it's short) - sending only the
+ *	characters that have changed. The cursor is re-positioned only when
+ *	we have to skip over more than one unchanged character; skipping just
+ *	the one is no dearer than sending it again.
+ *	The cursor position afterwards is just past the last change.
+ *********************************************************************************
+ */
+
+void lcdUpdate (const int fd, const char *fullScreen)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+  unsigned char *shadow ;
+  unsigned char c ;
+  int x, y ;
+
+  for (y = 0 ; y < lcd->rows ; ++y)
+    for (x = 0 ; x < lcd->cols ; ++x)
+    {
+      c = (*fullScreen == 0) ? ' ' : *fullScreen++ ;
+      shadow = &lcd->shadow [y * lcd->cols + x] ;
+
+      if (lcd->shadowValid && (*shadow == c))
+	continue ;
+
+      if (!lcd->addrValid || (lcd->cy != y) || (lcd->cx != x))
+      {
+	if (lcd->addrValid && (lcd->cy == y) && (lcd->cx == (x - 1)))
+	  sendDataCmd (lcd, *(shadow - 1), 1) ;
+	else
+	{
+	  lcd->cx        = x ;
+	  lcd->cy        = y ;
+	  lcd->addrValid = FALSE ;
+	  setAddress (lcd) ;
+	}
+      }
+
+      sendDataCmd (lcd, c, 1) ;
+      *shadow = c ;
+
+      lcd->cx = x + 1 ;
+      lcd->cy = y ;
+      if (lcd->cx == lcd->cols)		// Next row isn't next in the display's memory
+      {
+	lcd->cx = 0 ;
+	if (++lcd->cy == lcd->rows)
+	  lcd->cy = 0 ;
+	lcd->addrValid = FALSE ;
+      }
+    }
+
+  lcd->shadowValid = TRUE ;
+
+  if (cursorShown ())
+    setAddress (lcd) ;
+}
+
+
 /*
  * lcdPrintf:
  *	Printf to an LCD display
@@ -412,8 +556,17 @@ int lcdInit (const int rows, const int cols, const int bits,
   if (lcd == NULL)
     return -1 ;
 
+  if ((lcd->shadow = (unsigned char *)malloc (rows * cols + 1)) == NULL)
+  {
+    free (lcd) ;
+    return -1 ;
+  }
+  lcd->shadowValid = FALSE ;
+  lcd->addrValid   = FALSE ;
+
   lcd->rsPin   = rs ;
   lcd->strbPin = strb ;
+  lcd->rwPin   = -1 ;		// No busy checking unless asked for
   lcd->bits    = 8 ;		// For now - we'll set it properly later.
   lcd->rows    = rows ;
   lcd->cols    = cols ;
@@ -429,6 +582,12 @@ int lcdInit (const int rows, const int cols, const int bits,
   lcd->dataPins [6] = d6 ;
   lcd->dataPins [7] = d7 ;
 
+// RS goes after the data pins in use so they're all written together
+
+  for (i = 0 ; i < 8 ; ++i)
+    lcd->busPins [i] = lcd->dataPins [i] ;
+  lcd->busPins [bits] = rs ;
+
   lcds [lcdFd] = lcd ;
 
   digitalWrite (lcd->rsPin,   0) ; pinMode (lcd->rsPin,   OUTPUT) ;
@@ -490,6 +649,29 @@ int lcdInit (const int rows, const int cols, const int bits,
 
   putCommand (lcd, LCD_ENTRY   | LCD_ENTRY_ID) ;
   putCommand (lcd, LCD_CDSHIFT | LCD_CDSHIFT_RL) ;
+  lcd->addrValid = FALSE ;	// That moved the cursor on one
 
   return lcdFd ;
 }
+
+
+/*
+ * lcdBusyPin:
+ *	Tell us which pin the display's RW line is on. We'll then poll the
+ *	busy flag before each write instead of waiting for the worst case.
+ *	Give -1 to go back to fixed delays.
+ *********************************************************************************
+ */
+
+void lcdBusyPin (const int fd, const int rwPin)
+{
+  struct lcdDataStruct *lcd = lcds [fd] ;
+
+  lcd->rwPin = rwPin ;
+
+  if (rwPin != -1)
+  {
+    digitalWrite (rwPin, 0) ;
+    pinMode      (rwPin, OUTPUT) ;
+  }
+}
@@ -32,6 +32,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <wiringPi.h>
 
@@ -51,10 +52,25 @@
 #define	STROBE		12
 #define	RS		13
 
+#ifndef	TRUE
+#  define	TRUE	(1==1)
+#  define	FALSE	(1==2)
+#endif
+
 // Software copy of the framebuffer
-//	it's 8-bit deep although the display itself is only 1-bit deep.
+//	Packed 8 rows to a byte in pages, much like the display itself, so
+//	bit n of frameBuffer [p][x] is row p*8+n. We also keep a copy of
+//	what's actually on the display, and the range of columns in each
+//	page that have been drawn in since the last update, so the update
+//	only needs to send the bytes that really changed.
+
+#define	LCD_PAGES	(LCD_HEIGHT / 8)
 
-static unsigned char frameBuffer [LCD_WIDTH * LCD_HEIGHT] ;
+static unsigned char frameBuffer [LCD_PAGES][LCD_WIDTH] ;
+static unsigned char onScreen    [LCD_PAGES][LCD_WIDTH] ;
+static int           dirtyLo     [LCD_PAGES] ;
+static int           dirtyHi     [LCD_PAGES] ;
+static int           screenValid = FALSE ;
 
 static int maxX,    maxY ;
 static int lastX,   lastY ;
@@ -118,55 +134,106 @@ static void setLine (int line, const int chip)
 
 
 /*
- * lcd128x64update:
- *	Copy our software version to the real display
+ * setByte:
+ *	Update the bits in mask of a framebuffer byte, and note the column
+ *	as dirty if it actually changed.
  *********************************************************************************
  */
 
-void lcd128x64update (void)
+static void setByte (const int page, const int x, const unsigned char value, const unsigned char mask)
+{
+  unsigned char old = frameBuffer [page][x] ;
+  unsigned char new = (old & ~mask) | (value & mask) ;
+
+  if (new == old)
+    return ;
+
+  frameBuffer [page][x] = new ;
+
+  if (x < dirtyLo [page]) dirtyLo [page] = x ;
+  if (x > dirtyHi [page]) dirtyHi [page] = x ;
+}
+
+
+/*
+ * flipByte:
+ *	The display has the bits in each column the other way up to us
+ *********************************************************************************
+ */
+
+static unsigned char flipByte (unsigned char b)
 {
-  int line, x, y, fbLoc ;
+  b = ((b & 0xF0) >> 4) | ((b & 0x0F) << 4) ;
+  b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2) ;
+  b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1) ;
+
+  return b ;
+}
+
+
+/*
+ * updateHalf:
+ *	Send the changed bytes of one page to one half of the display. Each
+ *	chip runs its columns right to left as far as we're concerned, and
+ *	the column address auto-increments, so we only need to re-address
+ *	when we skip over bytes that haven't changed.
+ *********************************************************************************
+ */
+
+static void updateHalf (const int line, const int xMin, const int xMax, const int chip)
+{
+  int page = 7 - line ;
+  int lo, hi, x, next = -1 ;
   unsigned char byte ;
 
-// Left side 
+  lo = (dirtyLo [page] > xMin) ? dirtyLo [page] : xMin ;
+  hi = (dirtyHi [page] < xMax) ? dirtyHi [page] : xMax ;
 
-  for (line = 0 ; line < 8 ; ++line)
+  for (x = hi ; x >= lo ; --x)
   {
-    setCol  (0,    CS1) ;
-    setLine (line, CS1) ;
+    byte = frameBuffer [page][x] ;
 
-    for (x = 63 ; x >= 0 ; --x)
-    {
-      byte = 0 ;
-      for (y = 0 ; y < 8 ; ++y)
-      {
-	fbLoc = x + (((7 - line) * 8) + (7 - y)) * LCD_WIDTH ;
-	if (frameBuffer [fbLoc] != 0)
-	  byte |= (1 << y) ;
-      }
-      sendData (byte, CS1) ;
-    }
+    if (screenValid && (byte == onScreen [page][x]))
+      continue ;
+
+    if (next < 0)
+      setLine (line, chip) ;
+
+    if (x != next)
+      setCol (xMax - x, chip) ;
+
+    sendData (flipByte (byte), chip) ;
+    onScreen [page][x] = byte ;
+    next = x - 1 ;
   }
+}
 
-// Right side 
+
+/*
+ * lcd128x64update:
+ *	Copy our software version to the real display
+ *********************************************************************************
+ */
+
+void lcd128x64update (void)
+{
+  int line, page ;
 
   for (line = 0 ; line < 8 ; ++line)
   {
-    setCol  (0,    CS2) ;
-    setLine (line, CS2) ;
+    page = 7 - line ;
 
-    for (x = 127 ; x >= 64 ; --x)
-    {
-      byte = 0 ;
-      for (y = 0 ; y < 8 ; ++y)
-      {
-	fbLoc = x + (((7 - line) * 8) + (7 - y)) * LCD_WIDTH ;
-	if (frameBuffer [fbLoc] != 0)
-	  byte |= (1 << y) ;
-      }
-      sendData (byte, CS2) ;
-    }
+    if (dirtyLo [page] > dirtyHi [page])
+      continue ;
+
+    updateHalf (line,  0,  63, CS1) ;	// Left side
+    updateHalf (line, 64, 127, CS2) ;	// Right side
+
+    dirtyLo [page] = LCD_WIDTH ;
+    dirtyHi [page] = -1 ;
   }
+
+  screenValid = TRUE ;
 }
 
 
@@ -278,6 +345,145 @@ void lcd128x64getScreenSize (int *x, int *y)
 }
 
 
+/*
+ * writeStrip:
+ *	Write 8 vertically adjacent pixels, starting at physical row rowTop,
+ *	into a column of the framebuffer. They may straddle two pages and
+ *	anything off the display is clipped.
+ *********************************************************************************
+ */
+
+static void writeStrip (const int px, const int rowTop, unsigned int value, unsigned int mask)
+{
+  int shift, page ;
+
+  if ((px < 0) || (px >= LCD_WIDTH))
+    return ;
+
+  shift = rowTop & 7 ;
+  page  = (rowTop - shift) / 8 ;
+
+  value <<= shift ;
+  mask  <<= shift ;
+
+  if ((page >= 0) && (page < LCD_PAGES))
+    setByte (page,     px,  value       & 0xFF,  mask       & 0xFF) ;
+  if ((page >= -1) && (page < (LCD_PAGES - 1)))
+    setByte (page + 1, px, (value >> 8) & 0xFF, (mask >> 8) & 0xFF) ;
+}
+
+
+/*
+ * fillArea:
+ *	Fill the rectangle between two corners. Whatever the orientation it's
+ *	still a rectangle on the display, so we work out the physical corners
+ *	and fill each column a byte at a time. Lines and spans are just thin
+ *	rectangles.
+ *********************************************************************************
+ */
+
+static void fillArea (int x0, int y0, int x1, int y1, const int colour)
+{
+  int px, py, n, top, bot ;
+  unsigned char value = (colour == 0) ? 0 : 0xFF ;
+
+  lcd128x64orientCoordinates (&x0, &y0) ;
+  lcd128x64orientCoordinates (&x1, &y1) ;
+
+  if (x0 > x1) { px = x0 ; x0 = x1 ; x1 = px ; }
+  if (y0 > y1) { py = y0 ; y0 = y1 ; y1 = py ; }
+
+  if (x0 < 0)            x0 = 0 ;
+  if (x1 >= LCD_WIDTH)   x1 = LCD_WIDTH  - 1 ;
+  if (y0 < 0)            y0 = 0 ;
+  if (y1 >= LCD_HEIGHT)  y1 = LCD_HEIGHT - 1 ;
+
+  for (py = y0 ; py <= y1 ; py += n)
+  {
+    top = py & 7 ;
+    bot = ((py | 7) < y1) ? 7 : (y1 & 7) ;
+    n   = bot - top + 1 ;
+
+    for (px = x0 ; px <= x1 ; ++px)
+      setByte (py >> 3, px, value, ((0xFF >> (7 - bot)) & (0xFF << top))) ;
+  }
+}
+
+
+/*
+ * blitTile:
+ *	Draw up to an 8x8 block of a 1bpp bitmap (MSB is the leftmost pixel)
+ *	with its top left corner at x,top. Rather than go pixel by pixel we
+ *	work out which way the rows and columns run on the display and build
+ *	whole framebuffer bytes. A bgCol of -1 leaves the background alone.
+ *********************************************************************************
+ */
+
+static void blitTile (int x, int top, const unsigned char *rows, const int stride, const int nRows,
+	const unsigned char colMask, const int bgCol, const int fgCol)
+{
+  int x0 = x,     y0 = top ;
+  int xk = x + 1, yk = top ;
+  int xr = x,     yr = top - 1 ;
+  int dkx, dky, drx, dry ;
+  int i, j, rowTop, px ;
+  unsigned int v, m, row ;
+
+  lcd128x64orientCoordinates (&x0, &y0) ;	// Top left
+  lcd128x64orientCoordinates (&xk, &yk) ;	// One to the right
+  lcd128x64orientCoordinates (&xr, &yr) ;	// One down
+
+  dkx = xk - x0 ; dky = yk - y0 ;
+  drx = xr - x0 ; dry = yr - y0 ;
+
+  if (dkx == 0)		// Bitmap rows run down the display columns
+  {
+    rowTop = (dky > 0) ? y0 : y0 - 7 ;
+
+    for (i = 0 ; i < nRows ; ++i)
+    {
+      row = rows [i * stride] & colMask ;
+      px  = x0 + i * drx ;
+
+      if (dky > 0)
+      {
+	v = flipByte (row) ;
+	m = flipByte (colMask) ;
+      }
+      else
+      {
+	v = row ;
+	m = colMask ;
+      }
+
+      writeStrip (px, rowTop, ((fgCol == 0) ? 0 : v) | ((bgCol > 0) ? ~v : 0), (bgCol < 0) ? v : m) ;
+    }
+  }
+  else			// Bitmap columns run down the display columns
+  {
+    rowTop = (dry > 0) ? y0 : y0 - 7 ;
+
+    for (i = 0 ; i < 8 ; ++i)
+    {
+      if ((colMask & (0x80 >> i)) == 0)
+	continue ;
+
+      v = m = 0 ;
+      for (j = 0 ; j < nRows ; ++j)
+      {
+	row = (dry > 0) ? (1 << j) : (0x80 >> j) ;
+	m  |= row ;
+	if ((rows [j * stride] & (0x80 >> i)) != 0)
+	  v |= row ;
+      }
+
+      px = x0 + i * dkx ;
+      writeStrip (px, rowTop, ((fgCol == 0) ? 0 : v) | ((bgCol > 0) ? ~v : 0), (bgCol < 0) ? v : m) ;
+    }
+  }
+}
+
+
 /*
  *********************************************************************************
  * Standard Graphical Functions
@@ -301,7 +507,7 @@ void lcd128x64point (int x, int y, int colour)
   if ((x < 0) || (x >= LCD_WIDTH) || (y < 0) || (y >= LCD_HEIGHT))
     return ;
 
-  frameBuffer [x + y * LCD_WIDTH] = colour ;
+  setByte (y >> 3, x, (colour == 0) ? 0 : 0xFF, 1 << (y & 7)) ;
 }
 
 
@@ -320,6 +526,12 @@ void lcd128x64line (int x0, int y0, int x1, int y1, int colour)
   lastX = x1 ;
   lastY = y1 ;
 
+  if ((x0 == x1) || (y0 == y1))		// Straight line - fill it as a span
+  {
+    fillArea (x0, y0, x1, y1, colour) ;
+    return ;
+  }
+
   dx = abs (x1 - x0) ;
   dy = abs (y1 - y0) ;
 
@@ -366,18 +578,11 @@ void lcd128x64lineTo (int x, int y, int colour)
 
 void lcd128x64rectangle (int x1, int y1, int x2, int y2, int colour, int filled)
 {
-  register int x ;
-
   if (filled)
   {
-    /**/ if (x1 == x2)
-      lcd128x64line (x1, y1, x2, y2, colour) ;
-    else if (x1 < x2)
-      for (x = x1 ; x <= x2 ; ++x)
-	lcd128x64line (x, y1, x, y2, colour) ;
-    else
-      for (x = x2 ; x <= x1 ; ++x)
-	lcd128x64line (x, y1, x, y2, colour) ;
+    fillArea (x1, y1, x2, y2, colour) ;
+    lastX = (x1 > x2) ? x1 : x2 ;
+    lastY = y2 ;
   }
   else
   {
@@ -549,30 +754,38 @@ void lcd128x64ellipse (int cx, int cy, int xRadius, int yRadius, int colour, int
 
 void lcd128x64putchar (int x, int y, int c, int bgCol, int fgCol)
 {
-  int y1, y2 ;
+  blitTile (x, y + fontHeight - 1, font + (c & 0xFF) * fontHeight, 1, fontHeight, 0xFF, bgCol, fgCol) ;
 
-  unsigned char line ;
-  unsigned char *fontPtr ;
+  lastX = x + fontWidth - 1 ;
+  lastY = y ;
+}
 
-// Can't print if we're offscreen
 
-//if ((x < 0) || (x >= (maxX - fontWidth)) || (y < 0) || (y >= (maxY - fontHeight)))
-//  return ;
+/*
+ * lcd128x64bitmap:
+ *	Draw a 1bpp bitmap, width x height pixels, with its bottom left
+ *	corner at x,y. Rows are (width+7)/8 bytes, top row first with the
+ *	MSB as the leftmost pixel - the same as the font. Set bits are drawn
+ *	in fgCol, clear bits in bgCol, or left alone if bgCol is -1.
+ *	It's clipped to the display.
+ *********************************************************************************
+ */
 
-  fontPtr = font + c * fontHeight ;
+void lcd128x64bitmap (int x, int y, const unsigned char *bitmap, int width, int height, int bgCol, int fgCol)
+{
+  int stride = (width + 7) / 8 ;
+  int tx, ty, nRows, nCols ;
 
-  for (y1 = fontHeight - 1 ; y1 >= 0 ; --y1)
+  for (ty = 0 ; ty < height ; ty += 8)
   {
-    y2 = y + y1 ;
-    line = *fontPtr++ ;
-    lcd128x64point (x + 0, y2, (line & 0x80) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 1, y2, (line & 0x40) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 2, y2, (line & 0x20) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 3, y2, (line & 0x10) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 4, y2, (line & 0x08) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 5, y2, (line & 0x04) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 6, y2, (line & 0x02) == 0 ? bgCol : fgCol) ;
-    lcd128x64point (x + 7, y2, (line & 0x01) == 0 ? bgCol : fgCol) ;
+    nRows = ((height - ty) < 8) ? (height - ty) : 8 ;
+
+    for (tx = 0 ; tx < stride ; ++tx)
+    {
+      nCols = ((width - tx * 8) < 8) ? (width - tx * 8) : 8 ;
+      blitTile (x + tx * 8, y + height - 1 - ty, bitmap + ty * stride + tx, stride, nRows,
+	(0xFF << (8 - nCols)) & 0xFF, bgCol, fgCol) ;
+    }
   }
 }
 
@@ -626,11 +839,15 @@ void lcd128x64puts (int x, int y, const char *str, int bgCol, int fgCol)
 
 void lcd128x64clear (int colour)
 {
-  register int i ;
-  register unsigned char *ptr = frameBuffer ;
+  register int page ;
 
-  for (i = 0 ; i < (maxX * maxY) ; ++i)
-    *ptr++ = colour ;
+  memset (frameBuffer, (colour == 0) ? 0 : 0xFF, sizeof (frameBuffer)) ;
+
+  for (page = 0 ; page < LCD_PAGES ; ++page)
+  {
+    dirtyLo [page] = 0 ;
+    dirtyHi [page] = LCD_WIDTH - 1 ;
+  }
 }
 
 
@@ -665,6 +882,8 @@ int lcd128x64setup (void)
   sendCommand (0x3F, CS2) ;	// Display ON
   sendCommand (0xC0, CS2) ;	// Set display start line to 0
 
+  screenValid = FALSE ;		// Don't know what's on it yet
+
   lcd128x64clear          (0) ;
   lcd128x64setOrientation (0) ;
   lcd128x64update         () ;
@@ -33,6 +33,7 @@ extern void lcd128x64circle            (int  x, int  y, int  r, int colour, int
 extern void lcd128x64ellipse           (int cx, int cy, int xRadius, int yRadius, int colour, int filled) ;
 extern void lcd128x64putchar           (int  x, int  y, int c, int bgCol, int fgCol) ;
 extern void lcd128x64puts              (int  x, int  y, const char *str, int bgCol, int fgCol) ;
+extern void lcd128x64bitmap            (int  x, int  y, const unsigned char *bitmap, int width, int height, int bgCol, int fgCol) ;
 extern void lcd128x64update            (void) ;
 extern void lcd128x64clear             (int colour) ;
 
@@ -23,8 +23,9 @@
  */
 
 //#include <stdio.h>
-//#include <stdlib.h>
+#include <stdlib.h>
 //#include <unistd.h>
+#include <pthread.h>
 
 #include <wiringPi.h>
 
@@ -36,50 +37,125 @@
 #endif
 
 
+// The sensor's frame is an 80uS low, 80uS high response, then 40 bits
+//	each a 50uS low then a 26-28uS (0) or 70uS (1) high, all in about
+//	5mS, so 10mS of capture is plenty.
+
+#define	MAX_EDGES		100
+#define	CAPTURE_TIME		10000
+#define	MAX_PULSE		200
+
+// It won't answer again straight away, and not with anything new for 2 seconds
+
+#define	RETRY_DELAY		1000
+#define	MIN_INTERVAL		2000
+
+// Per-pin cache for maxDetectReadCached
+
+struct maxDetectCacheStruct
+{
+  int           pin ;
+  int           valid ;
+  unsigned int  nextTime ;
+  unsigned char buffer [4] ;
+
+  struct maxDetectCacheStruct *next ;
+} ;
+
+static struct maxDetectCacheStruct *maxDetectCache = NULL ;
+
+// Only one of us on the bus at a time, and it protects the lists
+
+static pthread_mutex_t maxDetectLock = PTHREAD_MUTEX_INITIALIZER ;
+
+
 /*
- * maxDetectLowHighWait:
- *	Wait for a transition from high to low on the bus
+ * maxDetectCapture:
+ *	Poll the pin as fast as we can for the length of a frame, noting the
+ *	time of every change of level rather than sampling at fixed times.
+ *	Returns the number of edges seen.
  *********************************************************************************
  */
 
-static void maxDetectLowHighWait (const int pin)
+static int maxDetectCapture (const int pin, unsigned int times [MAX_EDGES], int levels [MAX_EDGES])
 {
-  unsigned int timeOut = millis () + 2000 ;
+  unsigned int start, now ;
+  int last, level, edges = 0 ;
+
+  last  = digitalRead (pin) ;
+  start = micros () ;
 
-  while (digitalRead (pin) == HIGH)
-    if (millis () > timeOut)
-      return ;
+  while (edges < MAX_EDGES)
+  {
+    now   = micros () ;
+    level = digitalRead (pin) ;
+
+    if (level != last)
+    {
+      times  [edges] = now ;
+      levels [edges] = level ;
+      ++edges ;
+      last = level ;
+    }
+
+    if ((now - start) > CAPTURE_TIME)
+      break ;
+  }
 
-  while (digitalRead (pin) == LOW)
-    if (millis () > timeOut)
-      return ;
+  return edges ;
 }
 
 
 /*
- * maxDetectClockByte:
- *	Read in a single byte from the MaxDetect bus
+ * maxDetectDecode:
+ *	Turn the edge times into bits. Each bit is a low followed by a high;
+ *	a high longer than the low before it is a 1. Comparing the two like
+ *	this takes care of any skew in how fast we were polling. We take the
+ *	last 40 complete bits so it doesn't matter whether we caught the
+ *	sensor's response pulses.
  *********************************************************************************
  */
 
-static unsigned int maxDetectClockByte (const int pin)
+static int maxDetectDecode (unsigned int times [MAX_EDGES], int levels [MAX_EDGES], int edges, unsigned char localBuf [5])
 {
-  unsigned int byte = 0 ;
-  int bit ;
+  unsigned int lows [MAX_EDGES], highs [MAX_EDGES] ;
+  unsigned int low, high ;
+  int i, bit, bits = 0 ;
+
+// A complete bit ends with a falling edge, with the rising edge before it
 
-  for (bit = 0 ; bit < 8 ; ++bit)
+  for (i = 2 ; i < edges ; ++i)
   {
-    maxDetectLowHighWait (pin) ;
+    if ((levels [i] != LOW) || (levels [i - 1] != HIGH))
+      continue ;
 
-// bit starting now - we need to time it.
+    low  = times [i - 1] - times [i - 2] ;
+    high = times [i]     - times [i - 1] ;
 
-    delayMicroseconds (30) ;
-    byte <<= 1 ;
-    if (digitalRead (pin) == HIGH)	// It's a 1
-      byte |= 1 ;
+    lows  [bits] = low ;
+    highs [bits] = high ;
+    ++bits ;
   }
 
-  return byte ;
+  if (bits < 40)
+    return FALSE ;
+
+  for (i = 0 ; i < 5 ; ++i)
+    localBuf [i] = 0 ;
+
+  for (i = 0 ; i < 40 ; ++i)
+  {
+    low  = lows  [bits - 40 + i] ;
+    high = highs [bits - 40 + i] ;
+
+    if ((low > MAX_PULSE) || (high > MAX_PULSE))	// We were away too long
+      return FALSE ;
+
+    bit = (high > low) ? 1 : 0 ;
+    localBuf [i / 8] = (localBuf [i / 8] << 1) | bit ;
+  }
+
+  return TRUE ;
 }
 
 
@@ -92,9 +168,11 @@ static unsigned int maxDetectClockByte (const int pin)
 
 int maxDetectRead (const int pin, unsigned char buffer [4])
 {
-  int i ;
+  int i, edges ;
   unsigned int checksum ;
   unsigned char localBuf [5] ;
+  unsigned int  times  [MAX_EDGES] ;
+  int           levels [MAX_EDGES] ;
 
 // Wake up the RHT03 by pulling the data line low, then high
 //	Low for 10mS, high for 40uS.
@@ -104,62 +182,345 @@ int maxDetectRead (const int pin, unsigned char buffer [4])
   digitalWrite (pin, 1) ; delayMicroseconds (40) ;
   pinMode      (pin, INPUT) ;
 
-// Now wait for sensor to pull pin low
-
-  maxDetectLowHighWait (pin) ;
+// Capture the whole frame then work out what it said
 
-// and read in 5 bytes (40 bits)
+  edges = maxDetectCapture (pin, times, levels) ;
 
-  for (i = 0 ; i < 5 ; ++i)
-    localBuf [i] = maxDetectClockByte (pin) ;
+  if (!maxDetectDecode (times, levels, edges, localBuf))
+    return FALSE ;
 
   checksum = 0 ;
   for (i = 0 ; i < 4 ; ++i)
-  {
-    buffer [i] = localBuf [i] ;
     checksum += localBuf [i] ;
-  }
   checksum &= 0xFF ;
 
-  return checksum == localBuf [4] ;
+  if (checksum != localBuf [4])
+    return FALSE ;
+
+  for (i = 0 ; i < 4 ; ++i)
+    buffer [i] = localBuf [i] ;
+
+  return TRUE ;
 }
 
 
 /*
- * readRHT03:
- *	Read the Temperature & Humidity from an RHT03 sensor
+ * maxDetectReadRetry:
+ *	As above, but try up to tries times before giving up
  *********************************************************************************
  */
 
-int readRHT03 (const int pin, int *temp, int *rh)
+int maxDetectReadRetry (const int pin, unsigned char buffer [4], int tries)
 {
-  static unsigned int nextTime   = 0 ;
-  static          int lastTemp   = 0 ;
-  static          int lastRh     = 0 ;
-  static          int lastResult = TRUE ;
+  while (tries-- > 0)
+  {
+    if (maxDetectRead (pin, buffer))
+      return TRUE ;
 
-  unsigned char buffer [4] ;
+    if (tries > 0)
+      delay (RETRY_DELAY) ;
+  }
 
-// Don't read more than once a second
+  return FALSE ;
+}
 
-  if (millis () < nextTime)
+
+/*
+ * maxDetectReadCached:
+ *	Never waits on the sensor: if we've had a good reading from the pin
+ *	in the last 2 seconds (which is as often as it'll give us a new
+ *	one) that's returned, otherwise we make a single attempt - about
+ *	15mS - and remember it if it was good.
+ *********************************************************************************
+ */
+
+int maxDetectReadCached (const int pin, unsigned char buffer [4])
+{
+  struct maxDetectCacheStruct *cache ;
+  int i, ok = TRUE ;
+
+  pthread_mutex_lock (&maxDetectLock) ;
+
+  for (cache = maxDetectCache ; cache != NULL ; cache = cache->next)
+    if (cache->pin == pin)
+      break ;
+
+  if (cache == NULL)
   {
-    *temp = lastTemp ;
-    *rh   = lastRh ;
-    return lastResult ;
+    if ((cache = (struct maxDetectCacheStruct *)calloc (1, sizeof (struct maxDetectCacheStruct))) == NULL)
+    {
+      ok = maxDetectRead (pin, buffer) ;
+      pthread_mutex_unlock (&maxDetectLock) ;
+      return ok ;
+    }
+
+    cache->pin     = pin ;
+    cache->next    = maxDetectCache ;
+    maxDetectCache = cache ;
   }
-  
-  lastResult = maxDetectRead (pin, buffer) ;
 
-  if (lastResult)
+  if (!cache->valid || ((int)(millis () - cache->nextTime) >= 0))
   {
-    *temp      = lastTemp   = (buffer [2] * 256 + buffer [3]) ;
-    *rh        = lastRh     = (buffer [0] * 256 + buffer [1]) ;
-    nextTime   = millis () + 2000 ;
-    return TRUE ;
+    if ((ok = maxDetectRead (pin, cache->buffer)))
+    {
+      cache->valid    = TRUE ;
+      cache->nextTime = millis () + MIN_INTERVAL ;
+    }
   }
-  else
+
+  if (ok)
+    for (i = 0 ; i < 4 ; ++i)
+      buffer [i] = cache->buffer [i] ;
+
+  pthread_mutex_unlock (&maxDetectLock) ;
+
+  return ok ;
+}
+
+
+/*
+ *********************************************************************************
+ * RHT03 sensors
+ *	Each pin gets its own sensor with its own cached reading. Readings
+ *	are published with a sequence count (odd while it's being changed)
+ *	so they can be picked up without taking any locks, while the slow
+ *	business of reading the sensors is done one at a time under
+ *	maxDetectLock - by readRHT03 or by a background sampler thread.
+ *********************************************************************************
+ */
+
+struct rht03Struct
+{
+  int          pin ;
+  unsigned int nextTime ;
+
+  volatile unsigned int seq ;
+  int temp, rh, valid ;
+
+  struct rht03Struct *next ;
+} ;
+
+static struct rht03Struct * volatile rht03Sensors = NULL ;
+
+static pthread_t    rht03Thread ;
+static volatile int rht03Running  = FALSE ;
+static unsigned int rht03Interval = MIN_INTERVAL ;
+
+
+/*
+ * findSensor: addSensor:
+ *	Sensors are only ever added to the front of the list, and never
+ *	removed, so it's safe to search it without the lock.
+ *********************************************************************************
+ */
+
+static struct rht03Struct *findSensor (const int pin)
+{
+  struct rht03Struct *sensor ;
+
+  for (sensor = rht03Sensors ; sensor != NULL ; sensor = sensor->next)
+    if (sensor->pin == pin)
+      return sensor ;
+
+  return NULL ;
+}
+
+static struct rht03Struct *addSensor (const int pin)
+{
+  struct rht03Struct *sensor ;
+
+  pthread_mutex_lock (&maxDetectLock) ;
+
+  if ((sensor = findSensor (pin)) == NULL)
+    if ((sensor = (struct rht03Struct *)calloc (1, sizeof (struct rht03Struct))) != NULL)
+    {
+      sensor->pin  = pin ;
+      sensor->next = rht03Sensors ;
+      __sync_synchronize () ;
+      rht03Sensors = sensor ;
+    }
+
+  pthread_mutex_unlock (&maxDetectLock) ;
+
+  return sensor ;
+}
+
+
+/*
+ * latestSample:
+ *	Get a consistent copy of the sensor's last reading
+ *********************************************************************************
+ */
+
+static int latestSample (struct rht03Struct *sensor, int *temp, int *rh)
+{
+  unsigned int seq ;
+  int valid ;
+
+  do
   {
+    seq   = sensor->seq ;
+    __sync_synchronize () ;
+    *temp = sensor->temp ;
+    *rh   = sensor->rh ;
+    valid = sensor->valid ;
+    __sync_synchronize () ;
+  } while (((seq & 1) != 0) || (seq != sensor->seq)) ;
+
+  return valid ;
+}
+
+
+/*
+ * sampleSensor:
+ *	Read the sensor and publish the result. Call with maxDetectLock held.
+ *********************************************************************************
+ */
+
+static int sampleSensor (struct rht03Struct *sensor)
+{
+  unsigned char buffer [4] ;
+
+  if (!maxDetectRead (sensor->pin, buffer))
     return FALSE ;
+
+  ++sensor->seq ;
+  __sync_synchronize () ;
+    sensor->temp  = buffer [2] * 256 + buffer [3] ;
+    sensor->rh    = buffer [0] * 256 + buffer [1] ;
+    sensor->valid = TRUE ;
+  __sync_synchronize () ;
+  ++sensor->seq ;
+
+  sensor->nextTime = millis () + rht03Interval ;
+
+  return TRUE ;
+}
+
+
+/*
+ * readRHT03:
+ *	Read the Temperature & Humidity from an RHT03 sensor. Both are in
+ *	tenths, and the top bit (0x8000) of the temperature is its sign.
+ *	Don't read it more than once every 2 seconds - until then we just
+ *	hand back the last reading.
+ *********************************************************************************
+ */
+
+int readRHT03 (const int pin, int *temp, int *rh)
+{
+  struct rht03Struct *sensor ;
+  int ok = TRUE ;
+
+  if ((sensor = findSensor (pin)) == NULL)
+    if ((sensor = addSensor (pin)) == NULL)
+      return FALSE ;
+
+  if (!sensor->valid || ((int)(millis () - sensor->nextTime) >= 0))
+  {
+    pthread_mutex_lock (&maxDetectLock) ;
+      if (!sensor->valid || ((int)(millis () - sensor->nextTime) >= 0))	// Someone else may have just done it
+	ok = sampleSensor (sensor) ;
+    pthread_mutex_unlock (&maxDetectLock) ;
   }
+
+  if (!ok)
+    return FALSE ;
+
+  return latestSample (sensor, temp, rh) ;
+}
+
+
+/*
+ * rht03Setup:
+ *	Add a sensor for the background sampler to look after
+ *********************************************************************************
+ */
+
+int rht03Setup (const int pin)
+{
+  return (addSensor (pin) == NULL) ? -1 : 0 ;
+}
+
+
+/*
+ * rht03Sampler:
+ *	Background thread. Read each sensor when it's due - failures are
+ *	tried again a second later.
+ *********************************************************************************
+ */
+
+static void *rht03Sampler (void *arg)
+{
+  struct rht03Struct *sensor ;
+
+  while (rht03Running)
+  {
+    for (sensor = rht03Sensors ; (sensor != NULL) && rht03Running ; sensor = sensor->next)
+    {
+      if ((int)(millis () - sensor->nextTime) < 0)
+	continue ;
+
+      pthread_mutex_lock (&maxDetectLock) ;
+	if (!sampleSensor (sensor))
+	  sensor->nextTime = millis () + RETRY_DELAY ;
+      pthread_mutex_unlock (&maxDetectLock) ;
+    }
+
+    delay (50) ;
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * rht03Start: rht03Stop:
+ *	Start and stop the background sampler. Each sensor is read every
+ *	intervalMs, but never more often than every 2 seconds.
+ *********************************************************************************
+ */
+
+int rht03Start (const int intervalMs)
+{
+  if (rht03Running)
+    return 0 ;
+
+  rht03Interval = (intervalMs < MIN_INTERVAL) ? MIN_INTERVAL : intervalMs ;
+  rht03Running  = TRUE ;
+
+  if (pthread_create (&rht03Thread, NULL, rht03Sampler, NULL) != 0)
+  {
+    rht03Running = FALSE ;
+    return -1 ;
+  }
+
+  return 0 ;
+}
+
+void rht03Stop (void)
+{
+  if (!rht03Running)
+    return ;
+
+  rht03Running = FALSE ;
+  pthread_join (rht03Thread, NULL) ;
+}
+
+
+/*
+ * rht03Read:
+ *	Get the latest reading the sampler has for the sensor on the pin.
+ *	Never blocks. Returns FALSE if there hasn't been a good one yet.
+ *********************************************************************************
+ */
+
+int rht03Read (const int pin, int *temp, int *rh)
+{
+  struct rht03Struct *sensor ;
+
+  if ((sensor = findSensor (pin)) == NULL)
+    return FALSE ;
+
+  return latestSample (sensor, temp, rh) ;
 }
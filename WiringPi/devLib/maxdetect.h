@@ -29,12 +29,21 @@ extern "C" {
 
 // Main generic function
 
-int maxDetectRead (const int pin, unsigned char buffer [4]) ;
+int maxDetectRead       (const int pin, unsigned char buffer [4]) ;
+int maxDetectReadRetry  (const int pin, unsigned char buffer [4], int tries) ;
+int maxDetectReadCached (const int pin, unsigned char buffer [4]) ;
 
 // Individual sensors
 
 int readRHT03 (const int pin, int *temp, int *rh) ;
 
+// Background sampling of any number of RHT03s
+
+int  rht03Setup (const int pin) ;
+int  rht03Start (const int intervalMs) ;
+void rht03Stop  (void) ;
+int  rht03Read  (const int pin, int *temp, int *rh) ;
+
 #ifdef __cplusplus
 }
 #endif
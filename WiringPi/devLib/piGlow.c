@@ -22,6 +22,8 @@
  ***********************************************************************
  */
 
+#include <stdio.h>
+
 #include <wiringPi.h>
 #include <sn3218.h>
 
@@ -33,6 +35,41 @@ static int leg0 [6] = {  6,  7,  8,  5,  4,  9 } ;
 static int leg1 [6] = { 17, 16, 15, 13, 11, 10 } ;
 static int leg2 [6] = {  0,  1,  2,  3, 14, 12 } ;
 
+#ifndef	TRUE
+#  define	TRUE	(1==1)
+#  define	FALSE	(1==2)
+#endif
+
+
+/*
+ * beginUpdate: endUpdate:
+ *	The sn3218 driver keeps the only copy of what's on the LEDs. We
+ *	defer its writes while we change several, then flush so they all go
+ *	out and take effect together - unless the caller had it deferred
+ *	already, in which case it's theirs to flush.
+ *********************************************************************************
+ */
+
+static int beginUpdate (void)
+{
+  struct wiringPiNodeStruct *node ;
+  int wasDeferred ;
+
+  if ((node = wiringPiFindNode (PIGLOW_BASE)) == NULL)
+    return TRUE ;
+
+  wasDeferred = node->deferred ;
+  wiringPiNodeDefer (PIGLOW_BASE, TRUE) ;
+
+  return wasDeferred ;
+}
+
+static void endUpdate (int wasDeferred)
+{
+  if (!wasDeferred)
+    wiringPiNodeDefer (PIGLOW_BASE, FALSE) ;
+}
+
 
 /*
  * piGlow1:
@@ -65,7 +102,7 @@ void piGlow1 (const int leg, const int ring, const int intensity)
 
 void piGlowLeg (const int leg, const int intensity)
 {
-  int  i ;
+  int  i, wasDeferred ;
   int *legLeds ;
 
   if ((leg < 0) || (leg > 2))
@@ -78,8 +115,10 @@ void piGlowLeg (const int leg, const int intensity)
   else
     legLeds = leg2 ;
 
-  for (i = 0 ; i < 6 ; ++i)
-    analogWrite (PIGLOW_BASE + legLeds [i], intensity) ;
+  wasDeferred = beginUpdate () ;
+    for (i = 0 ; i < 6 ; ++i)
+      analogWrite (PIGLOW_BASE + legLeds [i], intensity) ;
+  endUpdate (wasDeferred) ;
 }
 
 
@@ -91,12 +130,16 @@ void piGlowLeg (const int leg, const int intensity)
 
 void piGlowRing (const int ring, const int intensity)
 {
+  int wasDeferred ;
+
   if ((ring < 0) || (ring > 5))
     return ;
 
-  analogWrite (PIGLOW_BASE + leg0 [ring], intensity) ;
-  analogWrite (PIGLOW_BASE + leg1 [ring], intensity) ;
-  analogWrite (PIGLOW_BASE + leg2 [ring], intensity) ;
+  wasDeferred = beginUpdate () ;
+    analogWrite (PIGLOW_BASE + leg0 [ring], intensity) ;
+    analogWrite (PIGLOW_BASE + leg1 [ring], intensity) ;
+    analogWrite (PIGLOW_BASE + leg2 [ring], intensity) ;
+  endUpdate (wasDeferred) ;
 }
 
 /*
@@ -107,12 +150,10 @@ void piGlowRing (const int ring, const int intensity)
 
 void piGlowSetup (int clear)
 {
+  static const uint8_t blank [18] = { 0 } ;
+
   sn3218Setup (PIGLOW_BASE) ;
 
   if (clear)
-  {
-    piGlowLeg (0, 0) ;
-    piGlowLeg (1, 0) ;
-    piGlowLeg (2, 0) ;
-  }
+    sn3218WriteAll (PIGLOW_BASE, blank) ;
 }
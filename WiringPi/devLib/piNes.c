@@ -22,6 +22,8 @@
  ***********************************************************************
  */
 
+#include <stdio.h>
+
 #include <wiringPi.h>
 
 #include "piNes.h"
@@ -41,15 +43,20 @@
 #define	PULSE_TIME	25
 
 // Data to store the pins for each controller
+//	Where we can, the pins are resolved to their GPIO registers at
+//	setup time so we don't go through digitalWrite for every edge.
 
 struct nesPinsStruct
 {
   unsigned int cPin, dPin, lPin ;
+  int fastCL, fastD ;
+  struct wpiPinRegs c, d, l ;
 } ;
 
 static struct nesPinsStruct nesPins [MAX_NES_JOYSTICKS] ;
 
 static int joysticks = 0 ;
+static int pulseTime = PULSE_TIME ;
 
 
 /*
@@ -60,12 +67,19 @@ static int joysticks = 0 ;
 
 int setupNesJoystick (int dPin, int cPin, int lPin)
 {
+  struct nesPinsStruct *pins ;
+
   if (joysticks == MAX_NES_JOYSTICKS)
     return -1 ;
 
-  nesPins [joysticks].dPin = dPin ;
-  nesPins [joysticks].cPin = cPin ;
-  nesPins [joysticks].lPin = lPin ;
+  pins = &nesPins [joysticks] ;
+
+  pins->dPin = dPin ;
+  pins->cPin = cPin ;
+  pins->lPin = lPin ;
+
+  pins->fastCL = wiringPiPinRegs (cPin, &pins->c) && wiringPiPinRegs (lPin, &pins->l) ;
+  pins->fastD  = wiringPiPinRegs (dPin, &pins->d) ;
 
   digitalWrite (lPin, LOW) ;
   digitalWrite (cPin, LOW) ;
@@ -78,6 +92,110 @@ int setupNesJoystick (int dPin, int cPin, int lPin)
 }
 
 
+/*
+ * setNesPulseTime:
+ *	Change the time in uS we hold the clock and latch edges for. The
+ *	4021 in the pad is happy with a lot less than the default, but long
+ *	cables may not be.
+ *********************************************************************************
+ */
+
+void setNesPulseTime (int uS)
+{
+  if (uS < 0)
+    uS = 0 ;
+
+  pulseTime = uS ;
+}
+
+
+/*
+ * pulse:
+ *	Send a high pulse on the clock or latch line and give the data
+ *	time to settle after it.
+ *********************************************************************************
+ */
+
+static void pulse (const struct nesPinsStruct *pins, const struct wpiPinRegs *regs, int pin)
+{
+  if (pins->fastCL)
+  {
+    *regs->set = regs->mask ; delayMicroseconds (pulseTime) ;
+    *regs->clr = regs->mask ; delayMicroseconds (pulseTime) ;
+  }
+  else
+  {
+    digitalWrite (pin, HIGH) ; delayMicroseconds (pulseTime) ;
+    digitalWrite (pin, LOW)  ; delayMicroseconds (pulseTime) ;
+  }
+}
+
+
+/*
+ * sample:
+ *	Read the next bit from each pad in the group. Pads with their data
+ *	lines in the same GPIO bank share the one register read.
+ *********************************************************************************
+ */
+
+static void sample (struct nesPinsStruct **pads, int n, unsigned int *values)
+{
+  volatile unsigned int *bank = NULL ;
+  unsigned int level = 0 ;
+  int i, bit ;
+
+  for (i = 0 ; i < n ; ++i)
+  {
+    if (pads [i]->fastD)
+    {
+      if (pads [i]->d.lev != bank)
+      {
+	bank  = pads [i]->d.lev ;
+	level = *bank ;
+      }
+      bit = (level & pads [i]->d.mask) != 0 ;
+    }
+    else
+      bit = digitalRead (pads [i]->dPin) ;
+
+    values [i] = (values [i] << 1) | bit ;
+  }
+}
+
+
+/*
+ * readGroup:
+ *	Scan a number of pads which share the clock and latch lines, all
+ *	at the same time.
+ *********************************************************************************
+ */
+
+static void readGroup (struct nesPinsStruct **pads, int n, unsigned int *values)
+{
+  struct nesPinsStruct *lead = pads [0] ;
+  int  i ;
+
+  for (i = 0 ; i < n ; ++i)
+    values [i] = 0 ;
+
+// Toggle Latch - which presents the first bit
+
+  pulse  (lead, &lead->l, lead->lPin) ;
+  sample (pads, n, values) ;
+
+// Now get the next 7 bits with the clock
+
+  for (i = 0 ; i < 7 ; ++i)
+  {
+    pulse  (lead, &lead->c, lead->cPin) ;
+    sample (pads, n, values) ;
+  }
+
+  for (i = 0 ; i < n ; ++i)
+    values [i] ^= 0xFF ;
+}
+
+
 /*
  * readNesJoystick:
  *	Do a single scan of the NES Joystick.
@@ -86,28 +204,60 @@ int setupNesJoystick (int dPin, int cPin, int lPin)
 
 unsigned int readNesJoystick (int joystick)
 {
-  unsigned int value = 0 ;
-  int  i ;
-
   struct nesPinsStruct *pins = &nesPins [joystick] ;
- 
-// Toggle Latch - which presents the first bit
+  unsigned int value ;
 
-  digitalWrite (pins->lPin, HIGH) ; delayMicroseconds (PULSE_TIME) ;
-  digitalWrite (pins->lPin, LOW)  ; delayMicroseconds (PULSE_TIME) ;
+  readGroup (&pins, 1, &value) ;
 
-// Read first bit
+  return value ;
+}
 
-  value = digitalRead (pins->dPin) ;
 
-// Now get the next 7 bits with the clock
+/*
+ * readNesJoysticks:
+ *	Scan several joysticks, putting the buttons for sticks [i] into
+ *	values [i]. Pads wired to the same clock and latch pins are all read
+ *	together, so 4 of them take no longer than one.
+ *	Returns the number of joysticks read.
+ *********************************************************************************
+ */
 
-  for (i = 0 ; i < 7 ; ++i)
+int readNesJoysticks (const int *sticks, unsigned int *values, int count)
+{
+  struct nesPinsStruct *pads [MAX_NES_JOYSTICKS] ;
+  unsigned int groupValues [MAX_NES_JOYSTICKS] ;
+  int index [MAX_NES_JOYSTICKS] ;
+  int done  [MAX_NES_JOYSTICKS] ;
+  struct nesPinsStruct *lead ;
+  int i, j, n ;
+
+  if (count > MAX_NES_JOYSTICKS)
+    count = MAX_NES_JOYSTICKS ;
+
+  for (i = 0 ; i < count ; ++i)
+    done [i] = 0 ;
+
+  for (i = 0 ; i < count ; ++i)
   {
-    digitalWrite (pins->cPin, HIGH) ; delayMicroseconds (PULSE_TIME) ;
-    digitalWrite (pins->cPin, LOW)  ; delayMicroseconds (PULSE_TIME) ;
-    value = (value << 1) | digitalRead (pins->dPin) ;
+    if (done [i])
+      continue ;
+
+    lead = &nesPins [sticks [i]] ;
+    n    = 0 ;
+
+    for (j = i ; j < count ; ++j)
+      if (!done [j] && (nesPins [sticks [j]].cPin == lead->cPin) && (nesPins [sticks [j]].lPin == lead->lPin))
+      {
+	pads  [n]   = &nesPins [sticks [j]] ;
+	index [n++] = j ;
+	done  [j]   = 1 ;
+      }
+
+    readGroup (pads, n, groupValues) ;
+
+    for (j = 0 ; j < n ; ++j)
+      values [index [j]] = groupValues [j] ;
   }
 
-  return value ^ 0xFF ;
+  return count ;
 }
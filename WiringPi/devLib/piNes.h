@@ -39,6 +39,8 @@ extern "C" {
 
 extern int          setupNesJoystick (int dPin, int cPin, int lPin) ;
 extern unsigned int  readNesJoystick (int joystick) ;
+extern int          readNesJoysticks (const int *sticks, unsigned int *values, int count) ;
+extern void         setNesPulseTime  (int uS) ;
 
 #ifdef __cplusplus
 }
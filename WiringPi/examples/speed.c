@@ -57,6 +57,29 @@ void speedTest (int pin, int maxCount)
   printf (": %7d/sec\n", perSec) ;
 }
 
+void speedTestRead (int pin, int maxCount)
+{
+  int count, sum, perSec, i ;
+  unsigned int start, end ;
+
+  sum = 0 ;
+
+  for (i = 0 ; i < PASSES ; ++i)
+  {
+    start = millis () ;
+    for (count = 0 ; count < maxCount ; ++count)
+      (void)digitalRead (pin) ;
+    end = millis () ;
+    printf (" %6d", end - start) ;
+    fflush (stdout) ;
+    sum += (end - start) ;
+  }
+
+  printf (". Av: %6dmS", sum / PASSES) ;
+  perSec = (int)(double)maxCount / (double)((double)sum / (double)PASSES) * 1000.0 ;
+  printf (": %7d/sec\n", perSec) ;
+}
+
 
 int main (void)
 {
@@ -91,5 +114,8 @@ int main (void)
   wiringPiSetupSys () ;
   speedTest (17, SLOW_COUNT) ;
 
+  printf ("\n/sys/class/gpio read: (%8d iterations)\n", SLOW_COUNT) ;
+  speedTestRead (17, SLOW_COUNT) ;
+
   return 0 ;
 }
@@ -762,7 +762,8 @@ static void doUsbP (int argc, char *argv [])
     
 // Need to force BCM_GPIO mode:
 
-  wiringPiSetupGpio () ;
+  if (wiringPiSetupGpio () < 0)
+    exit (1) ;
 
   if ((strcasecmp (argv [2], "high") == 0) || (strcasecmp (argv [2], "hi") == 0))
   {
@@ -1247,7 +1248,8 @@ int main (int argc, char *argv [])
 
   /**/ if (strcasecmp (argv [1], "-g") == 0)
   {
-    wiringPiSetupGpio () ;
+    if (wiringPiSetupGpio () < 0)
+      exit (EXIT_FAILURE) ;
 
     for (i = 2 ; i < argc ; ++i)
       argv [i - 1] = argv [i] ;
@@ -1259,7 +1261,8 @@ int main (int argc, char *argv [])
 
   else if (strcasecmp (argv [1], "-1") == 0)
   {
-    wiringPiSetupPhys () ;
+    if (wiringPiSetupPhys () < 0)
+      exit (EXIT_FAILURE) ;
 
     for (i = 2 ; i < argc ; ++i)
       argv [i - 1] = argv [i] ;
@@ -1283,7 +1286,8 @@ int main (int argc, char *argv [])
 
   else
   {
-    wiringPiSetup () ;
+    if (wiringPiSetup () < 0)
+      exit (EXIT_FAILURE) ;
     wpMode = WPI_MODE_PINS ;
   }
 
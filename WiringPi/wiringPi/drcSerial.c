@@ -23,6 +23,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <string.h>
 #include <errno.h>
@@ -38,6 +39,164 @@
 #endif
 
 
+// Per-node command buffer
+//	While the node is deferred (wiringPiNodeDefer) commands are queued
+//	here and sent in one write () when it's flushed - or when a read
+//	has to go out after them.
+
+#define	DRC_TX_MAX	256
+
+// How long to wait for a reply - the same as the serial port timeout
+
+#define	DRC_TIMEOUT	10000
+
+// How long the line has to stay quiet before we take it the rest of
+//	a short reply isn't coming
+
+#define	DRC_QUIET	20
+
+struct drcStruct
+{
+  struct wiringPiNodeStruct *node ;
+  int           txLen ;
+  unsigned char tx [DRC_TX_MAX] ;
+
+  struct drcStruct *next ;
+} ;
+
+static struct drcStruct *drcNodes = NULL ;
+
+
+/*
+ * findDrc:
+ *	Locate the command buffer for a node
+ *********************************************************************************
+ */
+
+static struct drcStruct *findDrc (struct wiringPiNodeStruct *node)
+{
+  struct drcStruct *drc ;
+
+  for (drc = drcNodes ; drc != NULL ; drc = drc->next)
+    if (drc->node == node)
+      return drc ;
+
+  return NULL ;
+}
+
+
+/*
+ * drcSend:
+ *	Send a command to the remote device. When deferring it's queued
+ *	up, otherwise it goes out along with anything already queued in a
+ *	single write.
+ *********************************************************************************
+ */
+
+static void drcSend (struct wiringPiNodeStruct *node, const unsigned char *cmd, int len, int now)
+{
+  struct drcStruct *drc = findDrc (node) ;
+
+  if (drc == NULL)
+  {
+    serialWrite (node->fd, cmd, len) ;
+    return ;
+  }
+
+  if (drc->txLen + len > DRC_TX_MAX)
+  {
+    serialWrite (node->fd, drc->tx, drc->txLen) ;
+    drc->txLen = 0 ;
+  }
+
+  memcpy (&drc->tx [drc->txLen], cmd, len) ;
+  drc->txLen += len ;
+
+  if (now || !node->deferred)
+  {
+    serialWrite (node->fd, drc->tx, drc->txLen) ;
+    drc->txLen = 0 ;
+  }
+  else
+    node->dirty = 1 ;
+}
+
+
+/*
+ * drcResync:
+ *	After a short reply the rest of it may still turn up later and
+ *	would be taken as the answer to the next command. Throw away what
+ *	comes in until the line goes quiet, then ping the remote end twice
+ *	and discard everything up to the two echoes back to back. A single
+ *	'@' won't do - it's a perfectly good byte of an analog reply, but
+ *	two of them (16448) isn't.
+ *********************************************************************************
+ */
+
+static void drcResync (struct wiringPiNodeStruct *node)
+{
+  unsigned char c, last = 0 ;
+
+  serialFlush (node->fd) ;
+  while (serialRead (node->fd, &c, 1, DRC_QUIET) == 1)
+    ;
+
+  serialPutchar (node->fd, '@') ;
+  serialPutchar (node->fd, '@') ;
+
+  while (serialRead (node->fd, &c, 1, DRC_TIMEOUT) == 1)
+  {
+    if ((c == '@') && (last == '@'))
+      break ;
+    last = c ;
+  }
+}
+
+
+/*
+ * drcReceive:
+ *	Wait for a reply of len bytes. Returns how many we actually got -
+ *	if that's short we resync with the remote end before returning.
+ *********************************************************************************
+ */
+
+static int drcReceive (struct wiringPiNodeStruct *node, unsigned char *reply, int len)
+{
+  int got = 0, x ;
+
+  while (got < len)
+  {
+    if ((x = serialRead (node->fd, reply + got, len - got, DRC_TIMEOUT)) <= 0)
+      break ;
+    got += x ;
+  }
+
+  if (got < len)
+    drcResync (node) ;
+
+  return got ;
+}
+
+
+/*
+ * myFlush:
+ *	Send everything queued up while deferred
+ *********************************************************************************
+ */
+
+static void myFlush (struct wiringPiNodeStruct *node)
+{
+  struct drcStruct *drc = findDrc (node) ;
+
+  if ((drc != NULL) && (drc->txLen != 0))
+  {
+    serialWrite (node->fd, drc->tx, drc->txLen) ;
+    drc->txLen = 0 ;
+  }
+  node->dirty = 0 ;
+}
+
+
 /*
  * myPinMode:
  *	Change the pin mode on the remote DRC device
@@ -46,14 +205,18 @@
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
+  unsigned char cmd [2] ;
+
   /**/ if (mode == OUTPUT)
-    serialPutchar (node->fd, 'o') ;       // Input
+    cmd [0] = 'o' ;       // Output
   else if (mode == PWM_OUTPUT)
-    serialPutchar (node->fd, 'p') ;       // PWM
+    cmd [0] = 'p' ;       // PWM
   else
-    serialPutchar (node->fd, 'i') ;       // Default to input
+    cmd [0] = 'i' ;       // Default to input
+
+  cmd [1] = pin - node->pinBase ;
 
-  serialPutchar (node->fd, pin - node->pinBase) ;
+  drcSend (node, cmd, 2, FALSE) ;
 }
 
 
@@ -65,22 +228,28 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 
 static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
 {
+  unsigned char cmd [4] ;
+  int len = 2 ;
 
 // Force pin into input mode
 
-  serialPutchar (node->fd, 'i' ) ;
-  serialPutchar (node->fd, pin - node->pinBase) ;
+  cmd [0] = 'i' ;
+  cmd [1] = pin - node->pinBase ;
 
   /**/ if (mode == PUD_UP)
   {
-    serialPutchar (node->fd, '1') ;
-    serialPutchar (node->fd, pin - node->pinBase) ;
+    cmd [2] = '1' ;
+    cmd [3] = pin - node->pinBase ;
+    len     = 4 ;
   }
   else if (mode == PUD_OFF)
   {
-    serialPutchar (node->fd, '0') ;
-    serialPutchar (node->fd, pin - node->pinBase) ;
+    cmd [2] = '0' ;
+    cmd [3] = pin - node->pinBase ;
+    len     = 4 ;
   }
+
+  drcSend (node, cmd, len, FALSE) ;
 }
 
 
@@ -91,8 +260,12 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  serialPutchar (node->fd, value == 0 ? '0' : '1') ;
-  serialPutchar (node->fd, pin - node->pinBase) ;
+  unsigned char cmd [2] ;
+
+  cmd [0] = (value == 0) ? '0' : '1' ;
+  cmd [1] = pin - node->pinBase ;
+
+  drcSend (node, cmd, 2, FALSE) ;
 }
 
 
@@ -103,9 +276,13 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
 static void myPwmWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  serialPutchar (node->fd, 'v') ;
-  serialPutchar (node->fd, pin - node->pinBase) ;
-  serialPutchar (node->fd, value & 0xFF) ;
+  unsigned char cmd [3] ;
+
+  cmd [0] = 'v' ;
+  cmd [1] = pin - node->pinBase ;
+  cmd [2] = value & 0xFF ;
+
+  drcSend (node, cmd, 3, FALSE) ;
 }
 
 
@@ -116,14 +293,17 @@ static void myPwmWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
 static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
-  int vHi, vLo ;
+  unsigned char cmd [2], reply [2] ;
 
-  serialPutchar (node->fd, 'a') ;
-  serialPutchar (node->fd, pin - node->pinBase) ;
-  vHi = serialGetchar (node->fd) ;
-  vLo = serialGetchar (node->fd) ;
+  cmd [0] = 'a' ;
+  cmd [1] = pin - node->pinBase ;
 
-  return (vHi << 8) | vLo ;
+  drcSend (node, cmd, 2, TRUE) ;
+
+  if (drcReceive (node, reply, 2) != 2)
+    return -1 ;
+
+  return (reply [0] << 8) | reply [1] ;
 }
 
 
@@ -134,9 +314,161 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 
 static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 {
-  serialPutchar (node->fd, 'r') ; // Send read command
-  serialPutchar (node->fd, pin - node->pinBase) ;
-  return (serialGetchar (node->fd) == '0') ? 0 : 1 ;
+  unsigned char cmd [2], reply ;
+
+  cmd [0] = 'r' ;	// Send read command
+  cmd [1] = pin - node->pinBase ;
+
+  drcSend (node, cmd, 2, TRUE) ;
+
+  if (drcReceive (node, &reply, 1) != 1)
+    return 0 ;
+
+  return (reply == '0') ? 0 : 1 ;
+}
+
+
+/*
+ * drcReadMany:
+ *	Pipelined reads. The remote end answers commands strictly in the
+ *	order they arrive, so rather than wait for each reply in turn we
+ *	send all the read commands in one write and then collect all the
+ *	replies - one round trip in total, however many pins.
+ *	Returns the number of values read, or -1 (including for any pin
+ *	that isn't on this node - nothing is sent then).
+ *********************************************************************************
+ */
+
+static int drcReadMany (struct wiringPiNodeStruct *node, const int *pins, int *values, const int n, const int analog)
+{
+  unsigned char *cmds, *replies ;
+  int i, got, replyLen = analog ? 2 : 1 ;
+
+  if (n <= 0)
+    return -1 ;
+
+  for (i = 0 ; i < n ; ++i)
+    if ((pins [i] < node->pinBase) || (pins [i] > node->pinMax))
+      return -1 ;
+
+  if ((cmds = malloc (n * 2 + n * replyLen)) == NULL)
+    return -1 ;
+  replies = cmds + n * 2 ;
+
+  for (i = 0 ; i < n ; ++i)
+  {
+    cmds [i * 2    ] = analog ? 'a' : 'r' ;
+    cmds [i * 2 + 1] = pins [i] - node->pinBase ;
+  }
+
+  myFlush     (node) ;
+  serialWrite (node->fd, cmds, n * 2) ;
+
+  got = drcReceive (node, replies, n * replyLen) / replyLen ;
+
+  for (i = 0 ; i < got ; ++i)
+    if (analog)
+      values [i] = (replies [i * 2] << 8) | replies [i * 2 + 1] ;
+    else
+      values [i] = (replies [i] == '0') ? 0 : 1 ;
+
+  free (cmds) ;
+
+  return got ;
+}
+
+
+/*
+ * drcDigitalReadMany: drcAnalogReadMany:
+ *	Read a list of pins on the one DRC node in a single round trip.
+ *	The pins are the usual wiringPi pin numbers, pinBase and up.
+ *********************************************************************************
+ */
+
+int drcDigitalReadMany (const int pinBase, const int *pins, int *values, const int n)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  return drcReadMany (node, pins, values, n, FALSE) ;
+}
+
+int drcAnalogReadMany (const int pinBase, const int *pins, int *values, const int n)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  return drcReadMany (node, pins, values, n, TRUE) ;
+}
+
+
+/*
+ * myAnalogReadMany:
+ *	A scan of the ATmega's 10-bit ADC channels in one round trip.
+ *	We don't know the reference voltage, so the samples are raw.
+ *********************************************************************************
+ */
+
+static int myAnalogReadMany (struct wiringPiNodeStruct *node, const int *chans, struct wpiSample *out, int n)
+{
+  int *pins, *values ;
+  int i, got ;
+
+  if (n <= 0)
+    return 0 ;
+
+  if ((pins = malloc (2 * n * sizeof (int))) == NULL)
+    return -1 ;
+  values = pins + n ;
+
+  for (i = 0 ; i < n ; ++i)
+    pins [i] = node->pinBase + chans [i] ;
+
+  got = drcReadMany (node, pins, values, n, TRUE) ;
+
+  for (i = 0 ; i < n ; ++i)
+  {
+    wiringPiSampleSet (&out [i], (i < got) ? values [i] : 0, 10, 1.0, 0.0, "") ;
+    if (i >= got)
+      out [i].flags |= WPI_SAMPLE_ERROR ;
+  }
+
+  free (pins) ;
+
+  return got ;
+}
+
+
+/*
+ * myDigitalReadPort:
+ *	Read all the node's pins (up to 32) in one round trip
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  int pins [32], values [32] ;
+  int i, n, got ;
+  unsigned int result = 0 ;
+
+  n = node->pinMax - node->pinBase + 1 ;
+  if (n > 32)
+    n = 32 ;
+
+  for (i = 0 ; i < n ; ++i)
+    pins [i] = node->pinBase + i ;
+
+  got = drcReadMany (node, pins, values, n, FALSE) ;
+
+  for (i = 0 ; i < got ; ++i)
+    if (values [i] != 0)
+      result |= 1U << i ;
+
+  return result ;
 }
 
 
@@ -154,6 +486,7 @@ int drcSetupSerial (const int pinBase, const int numPins, const char *device, co
   int ok, tries ;
   time_t then ;
   struct wiringPiNodeStruct *node ;
+  struct drcStruct *drc ;
 
   if ((fd = serialOpen (device, baud)) < 0)
     return wiringPiFailure (WPI_ALMOST, "Unable to open DRC device (%s): %s", device, strerror (errno)) ;
@@ -189,6 +522,13 @@ int drcSetupSerial (const int pinBase, const int numPins, const char *device, co
 
   node = wiringPiNewNode (pinBase, numPins) ;
 
+  if ((drc = (struct drcStruct *)calloc (1, sizeof (struct drcStruct))) != NULL)
+  {
+    drc->node = node ;
+    drc->next = drcNodes ;
+    drcNodes  = drc ;
+  }
+
   node->fd              = fd ;
   node->pinMode         = myPinMode ;
   node->pullUpDnControl = myPullUpDnControl ;
@@ -196,6 +536,9 @@ int drcSetupSerial (const int pinBase, const int numPins, const char *device, co
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
   node->pwmWrite        = myPwmWrite ;
+  node->flush           = myFlush ;
+  node->digitalReadPort = myDigitalReadPort ;
+  node->analogReadMany  = myAnalogReadMany ;
 
   return 0 ;
 }
@@ -28,6 +28,9 @@ extern "C" {
 
 extern int drcSetupSerial (const int pinBase, const int numPins, const char *device, const int baud) ;
 
+extern int drcDigitalReadMany (const int pinBase, const int *pins, int *values, const int n) ;
+extern int drcAnalogReadMany  (const int pinBase, const int *pins, int *values, const int n) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,24 @@
 
 #include "max31855.h"
 
+/*
+ * readData:
+ *	The chip sends all 32 bits MSB first
+ *********************************************************************************
+ */
+
+static unsigned int readData (struct wiringPiNodeStruct *node)
+{
+  unsigned char spiData [4] ;
+
+  spiData [0] = spiData [1] = spiData [2] = spiData [3] = 0 ;
+
+  wiringPiSPIDataRW (node->fd, spiData, 4) ;
+
+  return (spiData [0] << 24) | (spiData [1] << 16) | (spiData [2] << 8) | spiData [3] ;
+}
+
+
 /*
  * myAnalogRead:
  *	Return the analog value of the given pin
@@ -34,27 +52,51 @@
  *	here so we can read the error registers. Channel 0 will be the data
  *	channel, and 1 is the error register code.
  *	Note: Temperature returned is temp in C * 4, so divide result by 4
+ *	- or use analogReadEx which does it for you.
  *********************************************************************************
  */
 
 static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
-  unsigned int spiData ;
-  int temp ;
-  int chan = pin - node->pinBase ;
+  unsigned int spiData = readData (node) ;
+
+  if ((pin - node->pinBase) == 0)	// Read temp in C
+    return (int)spiData >> 18 ;		// Top 14 bits, sign extended
+  else					// Return error bits
+    return spiData & 0x7 ;
+}
+
+
+/*
+ * myAnalogReadEx:
+ *	As above, but channel 0 comes back in degrees C with the fault
+ *	bits turned into sample flags.
+ *********************************************************************************
+ */
+
+static int myAnalogReadEx (struct wiringPiNodeStruct *node, int pin, struct wpiSample *sample)
+{
+  unsigned int spiData = readData (node) ;
 
-  wiringPiSPIDataRW (node->fd, (unsigned char *)&spiData, 4) ;
+  if ((pin - node->pinBase) != 0)
+  {
+    wiringPiSampleSet (sample, spiData & 0x7, 3, 1.0, 0.0, "") ;
+    return 0 ;
+  }
+
+  wiringPiSampleSet (sample, (int)spiData >> 18, 14, 0.25, 0.0, "C") ;
 
-  if (chan == 0)			// Read temp in C
+  if ((spiData & 0x10000) != 0)		// Fault
   {
-    spiData >>= 18 ;
-    temp = spiData & 0x3FFF ;		// Bottom 13 bits
-    if ((spiData & 0x2000) != 0)	// Negative
-      temp = -temp ;
-    return temp ;
+    if ((spiData & 0x1) != 0)
+      sample->flags |= WPI_SAMPLE_OPEN ;
+    if ((spiData & 0x6) != 0)
+      sample->flags |= WPI_SAMPLE_SHORT ;
+    sample->flags |= WPI_SAMPLE_ERROR ;
+    return -1 ;
   }
-  else					// Return error bits
-    return spiData & 0x7 ;
+
+  return 0 ;
 }
 
 
@@ -74,8 +116,9 @@ int max31855Setup (const int pinBase, int spiChannel)
 
   node = wiringPiNewNode (pinBase, 2) ;
 
-  node->fd         = spiChannel ;
-  node->analogRead = myAnalogRead ;
+  node->fd           = spiChannel ;
+  node->analogRead   = myAnalogRead ;
+  node->analogReadEx = myAnalogReadEx ;
 
   return 0 ;
 }
@@ -41,6 +41,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
   int mask, old, reg ;
 
+  wiringPiI2CLock (node->fd) ;
+
   reg  = MCP23x08_IODIR ;
   mask = 1 << (pin - node->pinBase) ;
   old  = wiringPiI2CReadReg8 (node->fd, reg) ;
@@ -51,6 +53,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -63,6 +67,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 {
   int mask, old, reg ;
 
+  wiringPiI2CLock (node->fd) ;
+
   reg  = MCP23x08_GPPU ;
   mask = 1 << (pin - node->pinBase) ;
 
@@ -74,6 +80,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
     old &= (~mask) ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -86,6 +94,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   int bit, old ;
 
+  wiringPiI2CLock (node->fd) ;
+
   bit  = 1 << ((pin - node->pinBase) & 7) ;
 
   old = node->data2 ;
@@ -96,6 +106,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
   wiringPiI2CWriteReg8 (node->fd, MCP23x08_GPIO, old) ;
   node->data2 = old ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -118,6 +130,29 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 8 pins in one transaction
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  return wiringPiI2CReadReg8 (node->fd, MCP23x08_GPIO) & 0xFF ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  wiringPiI2CLock (node->fd) ;
+
+  node->data2 = (node->data2 & ~mask) | (value & mask & 0xFF) ;
+
+  wiringPiI2CWriteReg8 (node->fd, MCP23x08_GPIO, node->data2) ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
 /*
  * mcp23008Setup:
  *	Create a new instance of an MCP23008 I2C GPIO interface. We know it
@@ -143,6 +178,8 @@ int mcp23008Setup (const int pinBase, const int i2cAddress)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
   node->data2           = wiringPiI2CReadReg8 (fd, MCP23x08_OLAT) ;
 
   return 0 ;
@@ -41,6 +41,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
   int mask, old, reg ;
 
+  wiringPiI2CLock (node->fd) ;
+
   pin -= node->pinBase ;
 
   if (pin < 8)		// Bank A
@@ -60,6 +62,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -72,6 +76,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   int bit, old ;
 
+  wiringPiI2CLock (node->fd) ;
+
   pin -= node->pinBase ;	// Pin now 0-15
 
   bit = 1 << (pin & 7) ;
@@ -100,6 +106,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
     wiringPiI2CWriteReg8 (node->fd, MCP23016_GP1, old) ;
     node->data3 = old ;
   }
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -132,6 +140,31 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	The MCP23016 registers are accessed as pairs, so a 16-bit transfer
+ *	starting at GP0 covers both ports in one go.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  return wiringPiI2CReadReg16 (node->fd, MCP23016_GP0) & 0xFFFF ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  wiringPiI2CLock (node->fd) ;
+
+  node->data2 = (node->data2 & ~mask)        | ( value       & mask        & 0xFF) ;
+  node->data3 = (node->data3 & ~(mask >> 8)) | ((value >> 8) & (mask >> 8) & 0xFF) ;
+
+  wiringPiI2CWriteReg16 (node->fd, MCP23016_GP0, (node->data3 << 8) | node->data2) ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
 /*
  * mcp23016Setup:
  *	Create a new instance of an MCP23016 I2C GPIO interface. We know it
@@ -157,6 +190,8 @@ int mcp23016Setup (const int pinBase, const int i2cAddress)
   node->pinMode         = myPinMode ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
   node->data2           = wiringPiI2CReadReg8 (fd, MCP23016_OLAT0) ;
   node->data3           = wiringPiI2CReadReg8 (fd, MCP23016_OLAT1) ;
 
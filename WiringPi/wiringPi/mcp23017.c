@@ -31,6 +31,24 @@
 
 #include "mcp23017.h"
 
+// Interrupt handling
+//	One slot per chip with interrupts enabled - 8 is as many as
+//	can sit on one I2C bus.
+
+#define	MAX_INT_NODES	8
+
+struct mcp23017IntStruct
+{
+  struct wiringPiNodeStruct *node ;
+  int           hostPin ;
+  unsigned int  mask ;
+  unsigned int  last ;
+  void        (*callbacks [16])(int pin, int value) ;
+} ;
+
+static struct mcp23017IntStruct intNodes [MAX_INT_NODES] ;
+static pthread_mutex_t intMutex = PTHREAD_MUTEX_INITIALIZER ;
+
 
 /*
  * myPinMode:
@@ -41,6 +59,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
   int mask, old, reg ;
 
+  wiringPiI2CLock (node->fd) ;
+
   pin -= node->pinBase ;
 
   if (pin < 8)		// Bank A
@@ -60,6 +80,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -72,6 +94,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 {
   int mask, old, reg ;
 
+  wiringPiI2CLock (node->fd) ;
+
   pin -= node->pinBase ;
 
   if (pin < 8)		// Bank A
@@ -91,6 +115,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
     old &= (~mask) ;
 
   wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -103,6 +129,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   int bit, old ;
 
+  wiringPiI2CLock (node->fd) ;
+
   pin -= node->pinBase ;	// Pin now 0-15
 
   bit = 1 << (pin & 7) ;
@@ -116,8 +144,12 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
     else
       old |=   bit ;
 
-    wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPIOA, old) ;
     node->data2 = old ;
+
+    if (node->deferred)
+      node->dirty |= 1 ;
+    else
+      wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPIOA, old) ;
   }
   else				// Bank B
   {
@@ -128,9 +160,15 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
     else
       old |=   bit ;
 
-    wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPIOB, old) ;
     node->data3 = old ;
+
+    if (node->deferred)
+      node->dirty |= 2 ;
+    else
+      wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPIOB, old) ;
   }
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -163,6 +201,258 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myFlush:
+ *	Write out any ports with pending deferred writes. With IOCON.SEQOP set
+ *	and BANK = 0 the address pointer toggles between GPIOA and GPIOB, so
+ *	when both ports are dirty they go out as one 16-bit transaction.
+ *	Holds the bus lock so a deferred write from another thread can't
+ *	slip in between sending the shadows and marking them clean.
+ *********************************************************************************
+ */
+
+static void myFlush (struct wiringPiNodeStruct *node)
+{
+  wiringPiI2CLock (node->fd) ;
+
+  switch (node->dirty & 3)
+  {
+    case 1:
+      wiringPiI2CWriteReg8  (node->fd, MCP23x17_GPIOA, node->data2) ;
+      break ;
+
+    case 2:
+      wiringPiI2CWriteReg8  (node->fd, MCP23x17_GPIOB, node->data3) ;
+      break ;
+
+    case 3:
+      wiringPiI2CWriteReg16 (node->fd, MCP23x17_GPIOA, (node->data3 << 8) | node->data2) ;
+      break ;
+  }
+  node->dirty = 0 ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 16 pins at once. As with myFlush, the A/B pair is read or
+ *	written with a single 16-bit transfer. Writes honour deferred mode.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  return wiringPiI2CReadReg16 (node->fd, MCP23x17_GPIOA) & 0xFFFF ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  wiringPiI2CLock (node->fd) ;
+
+  node->data2 = (node->data2 & ~mask)        | ( value       & mask        & 0xFF) ;
+  node->data3 = (node->data3 & ~(mask >> 8)) | ((value >> 8) & (mask >> 8) & 0xFF) ;
+
+  if ((mask & 0x00FF) != 0) node->dirty |= 1 ;
+  if ((mask & 0xFF00) != 0) node->dirty |= 2 ;
+
+  if (!node->deferred)
+    myFlush (node) ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
+/*
+ * serviceInterrupt:
+ *	Called (from the wiringPiISR thread) when the chip pulls its INT line.
+ *	INTF says which pins caused it and INTCAP holds the port as it was
+ *	at that moment - those pins get reported with their captured value
+ *	even if they've since gone back again. Reading GPIO afterwards (which
+ *	also clears the interrupt) picks up anything else that moved while
+ *	INT was held low, as INTF won't flag those.
+ *********************************************************************************
+ */
+
+static void serviceInterrupt (struct mcp23017IntStruct *intNode)
+{
+  struct wiringPiNodeStruct *node = intNode->node ;
+  unsigned int flags, capture, now, changed, bit ;
+  int pin ;
+  void (*callback)(int pin, int value) ;
+
+  wiringPiI2CLock (node->fd) ;
+    flags   = wiringPiI2CReadReg16 (node->fd, MCP23x17_INTFA)   & 0xFFFF ;
+    capture = wiringPiI2CReadReg16 (node->fd, MCP23x17_INTCAPA) & 0xFFFF ;
+    now     = wiringPiI2CReadReg16 (node->fd, MCP23x17_GPIOA)   & 0xFFFF ;
+  wiringPiI2CUnlock (node->fd) ;
+
+  flags  &= intNode->mask ;
+  changed = (flags | (now ^ intNode->last)) & intNode->mask ;
+  intNode->last = now ;
+
+  for (pin = 0 ; pin < 16 ; ++pin)
+  {
+    bit = 1U << pin ;
+
+    if (((changed & bit) == 0) || ((callback = intNode->callbacks [pin]) == NULL))
+      continue ;
+
+    if ((flags & bit) != 0)
+    {
+      callback (node->pinBase + pin, (capture & bit) != 0) ;
+      if (((capture ^ now) & bit) == 0)
+	continue ;
+    }
+
+    callback (node->pinBase + pin, (now & bit) != 0) ;
+  }
+}
+
+// wiringPiISR only gives us a void function, so one per slot
+
+static void isr0 (void) { serviceInterrupt (&intNodes [0]) ; }
+static void isr1 (void) { serviceInterrupt (&intNodes [1]) ; }
+static void isr2 (void) { serviceInterrupt (&intNodes [2]) ; }
+static void isr3 (void) { serviceInterrupt (&intNodes [3]) ; }
+static void isr4 (void) { serviceInterrupt (&intNodes [4]) ; }
+static void isr5 (void) { serviceInterrupt (&intNodes [5]) ; }
+static void isr6 (void) { serviceInterrupt (&intNodes [6]) ; }
+static void isr7 (void) { serviceInterrupt (&intNodes [7]) ; }
+
+static void (*isrFunctions [MAX_INT_NODES])(void) =
+{
+  isr0, isr1, isr2, isr3, isr4, isr5, isr6, isr7,
+} ;
+
+
+/*
+ * findIntNode:
+ *	Return the interrupt slot for the chip that owns the given pin
+ *********************************************************************************
+ */
+
+static struct mcp23017IntStruct *findIntNode (int pin)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_INT_NODES ; ++i)
+    if ((intNodes [i].node != NULL) && (pin >= intNodes [i].node->pinBase) && (pin <= intNodes [i].node->pinMax))
+      return &intNodes [i] ;
+
+  return NULL ;
+}
+
+
+/*
+ * mcp23017EnableInterrupts:
+ *	Enable interrupt-on-change for the pins in mask (bit 0 = pinBase)
+ *	and hook the chip's INTA output up to the given on-board pin.
+ *	INTA and INTB are mirrored, so only the one wire is needed.
+ *	The pins should already be set as inputs. Calling it again changes
+ *	the mask, but the host pin is fixed once set as there's no way to
+ *	take a wiringPiISR handler off its pin again.
+ *********************************************************************************
+ */
+
+int mcp23017EnableInterrupts (const int pinBase, const int hostIntPin, const int mask)
+{
+  struct wiringPiNodeStruct *node ;
+  struct mcp23017IntStruct  *intNode ;
+  int i, slot ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return wiringPiFailure (WPI_ALMOST, "mcp23017EnableInterrupts: No node at pin %d\n", pinBase) ;
+
+  if (node->flush != myFlush)
+    return wiringPiFailure (WPI_ALMOST, "mcp23017EnableInterrupts: Pin %d is not on an MCP23017\n", pinBase) ;
+
+  pthread_mutex_lock (&intMutex) ;
+
+  if ((intNode = findIntNode (pinBase)) == NULL)
+  {
+    for (slot = -1, i = 0 ; i < MAX_INT_NODES ; ++i)
+      if (intNodes [i].node == NULL)
+      {
+	slot = i ;
+	break ;
+      }
+
+    if (slot == -1)
+    {
+      pthread_mutex_unlock (&intMutex) ;
+      return wiringPiFailure (WPI_ALMOST, "mcp23017EnableInterrupts: Too many chips (max %d)\n", MAX_INT_NODES) ;
+    }
+
+    intNode          = &intNodes [slot] ;
+    intNode->node    = node ;
+    intNode->hostPin = -1 ;
+  }
+  else
+  {
+    if ((intNode->hostPin != -1) && (intNode->hostPin != hostIntPin))
+    {
+      pthread_mutex_unlock (&intMutex) ;
+      return wiringPiFailure (WPI_ALMOST, "mcp23017EnableInterrupts: Already using host pin %d\n", intNode->hostPin) ;
+    }
+    slot = intNode - intNodes ;
+  }
+
+  intNode->mask = mask & 0xFFFF ;
+
+// Compare against the previous value (INTCON = 0) so any change fires,
+//	with INTA/B mirrored onto the one line.
+
+  wiringPiI2CLock (node->fd) ;
+    wiringPiI2CWriteReg8  (node->fd, MCP23x17_IOCON,    IOCON_INIT | IOCON_MIRROR) ;
+    wiringPiI2CWriteReg16 (node->fd, MCP23x17_INTCONA,  0) ;
+    wiringPiI2CWriteReg16 (node->fd, MCP23x17_GPINTENA, intNode->mask) ;
+
+// Reading the port clears anything pending and gives us our starting state
+
+    intNode->last = wiringPiI2CReadReg16 (node->fd, MCP23x17_GPIOA) & 0xFFFF ;
+  wiringPiI2CUnlock (node->fd) ;
+
+  if (intNode->hostPin == -1)
+  {
+    intNode->hostPin = hostIntPin ;
+    pthread_mutex_unlock (&intMutex) ;
+    return wiringPiISR (hostIntPin, INT_EDGE_FALLING, isrFunctions [slot]) ;
+  }
+
+  pthread_mutex_unlock (&intMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * mcp23017ISR:
+ *	Register a function to be called when an interrupt-enabled pin on
+ *	an MCP23017 changes. It's called with the pin number and its new
+ *	value, from the interrupt thread. Pass NULL to remove it.
+ *********************************************************************************
+ */
+
+int mcp23017ISR (const int pin, void (*function)(int pin, int value))
+{
+  struct mcp23017IntStruct *intNode ;
+
+  pthread_mutex_lock (&intMutex) ;
+
+  if ((intNode = findIntNode (pin)) == NULL)
+  {
+    pthread_mutex_unlock (&intMutex) ;
+    return wiringPiFailure (WPI_ALMOST, "mcp23017ISR: Interrupts not enabled for pin %d\n", pin) ;
+  }
+
+  intNode->callbacks [pin - intNode->node->pinBase] = function ;
+
+  pthread_mutex_unlock (&intMutex) ;
+  return 0 ;
+}
+
+
 /*
  * mcp23017Setup:
  *	Create a new instance of an MCP23017 I2C GPIO interface. We know it
@@ -188,6 +478,9 @@ int mcp23017Setup (const int pinBase, const int i2cAddress)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
+  node->flush           = myFlush ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
   node->data2           = wiringPiI2CReadReg8 (fd, MCP23x17_OLATA) ;
   node->data3           = wiringPiI2CReadReg8 (fd, MCP23x17_OLATB) ;
 
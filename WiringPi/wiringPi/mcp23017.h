@@ -28,6 +28,9 @@ extern "C" {
 
 extern int mcp23017Setup (const int pinBase, const int i2cAddress) ;
 
+extern int mcp23017EnableInterrupts (const int pinBase, const int hostIntPin, const int mask) ;
+extern int mcp23017ISR              (const int pin, void (*function)(int pin, int value)) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -80,6 +80,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
   int mask, old, reg ;
 
+  wiringPiSPILock (node->data0) ;
+
   reg  = MCP23x08_IODIR ;
   mask = 1 << (pin - node->pinBase) ;
   old  = readByte (node->data0, node->data1, reg) ;
@@ -90,6 +92,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+
+  wiringPiSPIUnlock (node->data0) ;
 }
 
 
@@ -102,6 +106,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 {
   int mask, old, reg ;
 
+  wiringPiSPILock (node->data0) ;
+
   reg  = MCP23x08_GPPU ;
   mask = 1 << (pin - node->pinBase) ;
 
@@ -113,6 +119,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
     old &= (~mask) ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+
+  wiringPiSPIUnlock (node->data0) ;
 }
 
 
@@ -125,6 +133,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   int bit, old ;
 
+  wiringPiSPILock (node->data0) ;
+
   bit  = 1 << ((pin - node->pinBase) & 7) ;
 
   old = node->data2 ;
@@ -135,6 +145,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
   writeByte (node->data0, node->data1, MCP23x08_GPIO, old) ;
   node->data2 = old ;
+
+  wiringPiSPIUnlock (node->data0) ;
 }
 
 
@@ -157,6 +169,29 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 8 pins in one transaction
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  return readByte (node->data0, node->data1, MCP23x08_GPIO) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  wiringPiSPILock (node->data0) ;
+
+  node->data2 = (node->data2 & ~mask) | (value & mask & 0xFF) ;
+
+  writeByte (node->data0, node->data1, MCP23x08_GPIO, node->data2) ;
+
+  wiringPiSPIUnlock (node->data0) ;
+}
+
+
 /*
  * mcp23s08Setup:
  *	Create a new instance of an MCP23s08 SPI GPIO interface. We know it
@@ -183,6 +218,8 @@ int mcp23s08Setup (const int pinBase, const int spiPort, const int devId)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
   node->data2           = readByte (spiPort, devId, MCP23x08_OLAT) ;
 
   return 0 ;
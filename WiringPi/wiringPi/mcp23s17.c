@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include "wiringPi.h"
 #include "wiringPiSPI.h"
@@ -33,6 +34,23 @@
 
 #define	MCP_SPEED	4000000
 
+// Interrupt handling
+//	One slot per chip with interrupts enabled - 8 covers the hardware
+//	addresses on one chip-select.
+
+#define	MAX_INT_NODES	8
+
+struct mcp23s17IntStruct
+{
+  struct wiringPiNodeStruct *node ;
+  int           hostPin ;
+  unsigned int  mask ;
+  unsigned int  last ;
+  void        (*callbacks [16])(int pin, int value) ;
+} ;
+
+static struct mcp23s17IntStruct intNodes [MAX_INT_NODES] ;
+static pthread_mutex_t intMutex = PTHREAD_MUTEX_INITIALIZER ;
 
 
 /*
@@ -71,6 +89,46 @@ static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 }
 
 
+/*
+ * readWord:
+ *	Read a register pair (A in the low byte, B in the high byte) in one
+ *	SPI transfer.
+ *********************************************************************************
+ */
+
+static unsigned int readWord (uint8_t spiPort, uint8_t devId, uint8_t reg)
+{
+  uint8_t spiData [4] ;
+
+  spiData [0] = CMD_READ | ((devId & 7) << 1) ;
+  spiData [1] = reg ;
+
+  wiringPiSPIDataRW (spiPort, spiData, 4) ;
+
+  return (spiData [3] << 8) | spiData [2] ;
+}
+
+
+/*
+ * writeWord:
+ *	Write a register pair (A from the low byte, B from the high byte)
+ *	in one SPI transfer.
+ *********************************************************************************
+ */
+
+static void writeWord (uint8_t spiPort, uint8_t devId, uint8_t reg, unsigned int data)
+{
+  uint8_t spiData [4] ;
+
+  spiData [0] = CMD_WRITE | ((devId & 7) << 1) ;
+  spiData [1] = reg ;
+  spiData [2] = data        & 0xFF ;
+  spiData [3] = (data >> 8) & 0xFF ;
+
+  wiringPiSPIDataRW (spiPort, spiData, 4) ;
+}
+
+
 /*
  * myPinMode:
  *********************************************************************************
@@ -80,6 +138,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
   int mask, old, reg ;
 
+  wiringPiSPILock (node->data0) ;
+
   pin -= node->pinBase ;
 
   if (pin < 8)		// Bank A
@@ -99,6 +159,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+
+  wiringPiSPIUnlock (node->data0) ;
 }
 
 
@@ -111,6 +173,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 {
   int mask, old, reg ;
 
+  wiringPiSPILock (node->data0) ;
+
   pin -= node->pinBase ;
 
   if (pin < 8)		// Bank A
@@ -130,6 +194,8 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
     old &= (~mask) ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+
+  wiringPiSPIUnlock (node->data0) ;
 }
 
 
@@ -142,6 +208,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   int bit, old ;
 
+  wiringPiSPILock (node->data0) ;
+
   pin -= node->pinBase ;	// Pin now 0-15
 
   bit = 1 << (pin & 7) ;
@@ -155,8 +223,12 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
     else
       old |=   bit ;
 
-    writeByte (node->data0, node->data1, MCP23x17_GPIOA, old) ;
     node->data2 = old ;
+
+    if (node->deferred)
+      node->dirty |= 1 ;
+    else
+      writeByte (node->data0, node->data1, MCP23x17_GPIOA, old) ;
   }
   else				// Bank B
   {
@@ -167,9 +239,15 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
     else
       old |=   bit ;
 
-    writeByte (node->data0, node->data1, MCP23x17_GPIOB, old) ;
     node->data3 = old ;
+
+    if (node->deferred)
+      node->dirty |= 2 ;
+    else
+      writeByte (node->data0, node->data1, MCP23x17_GPIOB, old) ;
   }
+
+  wiringPiSPIUnlock (node->data0) ;
 }
 
 
@@ -202,6 +280,260 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myFlush:
+ *	Push out the deferred port writes. If both ports are dirty then
+ *	it's a single 4-byte transfer: GPIOA then GPIOB (the register pointer
+ *	toggles between the pair as we run with SEQOP set). The dirty bits
+ *	are cleared under the bus lock along with the transfer.
+ *********************************************************************************
+ */
+
+static void myFlush (struct wiringPiNodeStruct *node)
+{
+  uint8_t spiData [4] ;
+
+  wiringPiSPILock (node->data0) ;
+
+  switch (node->dirty & 3)
+  {
+    case 1:
+      writeByte (node->data0, node->data1, MCP23x17_GPIOA, node->data2) ;
+      break ;
+
+    case 2:
+      writeByte (node->data0, node->data1, MCP23x17_GPIOB, node->data3) ;
+      break ;
+
+    case 3:
+      spiData [0] = CMD_WRITE | ((node->data1 & 7) << 1) ;
+      spiData [1] = MCP23x17_GPIOA ;
+      spiData [2] = node->data2 ;
+      spiData [3] = node->data3 ;
+      wiringPiSPIDataRW (node->data0, spiData, 4) ;
+      break ;
+  }
+  node->dirty = 0 ;
+
+  wiringPiSPIUnlock (node->data0) ;
+}
+
+
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 16 pins at once, in a single SPI transfer each way.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  return readWord (node->data0, node->data1, MCP23x17_GPIOA) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  wiringPiSPILock (node->data0) ;
+
+  node->data2 = (node->data2 & ~mask)        | ( value       & mask        & 0xFF) ;
+  node->data3 = (node->data3 & ~(mask >> 8)) | ((value >> 8) & (mask >> 8) & 0xFF) ;
+
+  if ((mask & 0x00FF) != 0) node->dirty |= 1 ;
+  if ((mask & 0xFF00) != 0) node->dirty |= 2 ;
+
+  if (!node->deferred)
+    myFlush (node) ;
+
+  wiringPiSPIUnlock (node->data0) ;
+}
+
+
+/*
+ * serviceInterrupt:
+ *	Called (from the wiringPiISR thread) when the chip pulls its INT line.
+ *	Pins flagged in INTF are reported with the value INTCAP latched for
+ *	them, so a short pulse isn't lost, then GPIO is read (clearing the
+ *	interrupt) to catch anything else that moved while INT was low.
+ *********************************************************************************
+ */
+
+static void serviceInterrupt (struct mcp23s17IntStruct *intNode)
+{
+  struct wiringPiNodeStruct *node = intNode->node ;
+  unsigned int flags, capture, now, changed, bit ;
+  int pin ;
+  void (*callback)(int pin, int value) ;
+
+  wiringPiSPILock (node->data0) ;
+    flags   = readWord (node->data0, node->data1, MCP23x17_INTFA) ;
+    capture = readWord (node->data0, node->data1, MCP23x17_INTCAPA) ;
+    now     = readWord (node->data0, node->data1, MCP23x17_GPIOA) ;
+  wiringPiSPIUnlock (node->data0) ;
+
+  flags  &= intNode->mask ;
+  changed = (flags | (now ^ intNode->last)) & intNode->mask ;
+  intNode->last = now ;
+
+  for (pin = 0 ; pin < 16 ; ++pin)
+  {
+    bit = 1U << pin ;
+
+    if (((changed & bit) == 0) || ((callback = intNode->callbacks [pin]) == NULL))
+      continue ;
+
+    if ((flags & bit) != 0)
+    {
+      callback (node->pinBase + pin, (capture & bit) != 0) ;
+      if (((capture ^ now) & bit) == 0)
+	continue ;
+    }
+
+    callback (node->pinBase + pin, (now & bit) != 0) ;
+  }
+}
+
+// wiringPiISR only gives us a void function, so one per slot
+
+static void isr0 (void) { serviceInterrupt (&intNodes [0]) ; }
+static void isr1 (void) { serviceInterrupt (&intNodes [1]) ; }
+static void isr2 (void) { serviceInterrupt (&intNodes [2]) ; }
+static void isr3 (void) { serviceInterrupt (&intNodes [3]) ; }
+static void isr4 (void) { serviceInterrupt (&intNodes [4]) ; }
+static void isr5 (void) { serviceInterrupt (&intNodes [5]) ; }
+static void isr6 (void) { serviceInterrupt (&intNodes [6]) ; }
+static void isr7 (void) { serviceInterrupt (&intNodes [7]) ; }
+
+static void (*isrFunctions [MAX_INT_NODES])(void) =
+{
+  isr0, isr1, isr2, isr3, isr4, isr5, isr6, isr7,
+} ;
+
+
+/*
+ * findIntNode:
+ *	Return the interrupt slot for the chip that owns the given pin
+ *********************************************************************************
+ */
+
+static struct mcp23s17IntStruct *findIntNode (int pin)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_INT_NODES ; ++i)
+    if ((intNodes [i].node != NULL) && (pin >= intNodes [i].node->pinBase) && (pin <= intNodes [i].node->pinMax))
+      return &intNodes [i] ;
+
+  return NULL ;
+}
+
+
+/*
+ * mcp23s17EnableInterrupts:
+ *	Enable interrupt-on-change for the pins in mask (bit 0 = pinBase)
+ *	and hook the chip's INTA output up to the given on-board pin.
+ *	INTA and INTB are mirrored, so only the one wire is needed.
+ *	The pins should already be set as inputs. Calling it again changes
+ *	the mask, but the host pin is fixed once set as there's no way to
+ *	take a wiringPiISR handler off its pin again.
+ *********************************************************************************
+ */
+
+int mcp23s17EnableInterrupts (const int pinBase, const int hostIntPin, const int mask)
+{
+  struct wiringPiNodeStruct *node ;
+  struct mcp23s17IntStruct  *intNode ;
+  int i, slot ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return wiringPiFailure (WPI_ALMOST, "mcp23s17EnableInterrupts: No node at pin %d\n", pinBase) ;
+
+  if (node->flush != myFlush)
+    return wiringPiFailure (WPI_ALMOST, "mcp23s17EnableInterrupts: Pin %d is not on an MCP23S17\n", pinBase) ;
+
+  pthread_mutex_lock (&intMutex) ;
+
+  if ((intNode = findIntNode (pinBase)) == NULL)
+  {
+    for (slot = -1, i = 0 ; i < MAX_INT_NODES ; ++i)
+      if (intNodes [i].node == NULL)
+      {
+	slot = i ;
+	break ;
+      }
+
+    if (slot == -1)
+    {
+      pthread_mutex_unlock (&intMutex) ;
+      return wiringPiFailure (WPI_ALMOST, "mcp23s17EnableInterrupts: Too many chips (max %d)\n", MAX_INT_NODES) ;
+    }
+
+    intNode          = &intNodes [slot] ;
+    intNode->node    = node ;
+    intNode->hostPin = -1 ;
+  }
+  else
+  {
+    if ((intNode->hostPin != -1) && (intNode->hostPin != hostIntPin))
+    {
+      pthread_mutex_unlock (&intMutex) ;
+      return wiringPiFailure (WPI_ALMOST, "mcp23s17EnableInterrupts: Already using host pin %d\n", intNode->hostPin) ;
+    }
+    slot = intNode - intNodes ;
+  }
+
+  intNode->mask = mask & 0xFFFF ;
+
+// Compare against the previous value (INTCON = 0) so any change fires,
+//	with INTA/B mirrored onto the one line.
+
+  wiringPiSPILock (node->data0) ;
+    writeByte (node->data0, node->data1, MCP23x17_IOCON, IOCON_INIT | IOCON_HAEN | IOCON_MIRROR) ;
+    writeWord (node->data0, node->data1, MCP23x17_INTCONA,  0) ;
+    writeWord (node->data0, node->data1, MCP23x17_GPINTENA, intNode->mask) ;
+
+// Reading the port clears anything pending and gives us our starting state
+
+    intNode->last = readWord (node->data0, node->data1, MCP23x17_GPIOA) ;
+  wiringPiSPIUnlock (node->data0) ;
+
+  if (intNode->hostPin == -1)
+  {
+    intNode->hostPin = hostIntPin ;
+    pthread_mutex_unlock (&intMutex) ;
+    return wiringPiISR (hostIntPin, INT_EDGE_FALLING, isrFunctions [slot]) ;
+  }
+
+  pthread_mutex_unlock (&intMutex) ;
+  return 0 ;
+}
+
+
+/*
+ * mcp23s17ISR:
+ *	Register a function to be called when an interrupt-enabled pin on
+ *	an MCP23S17 changes. It's called with the pin number and its new
+ *	value, from the interrupt thread. Pass NULL to remove it.
+ *********************************************************************************
+ */
+
+int mcp23s17ISR (const int pin, void (*function)(int pin, int value))
+{
+  struct mcp23s17IntStruct *intNode ;
+
+  pthread_mutex_lock (&intMutex) ;
+
+  if ((intNode = findIntNode (pin)) == NULL)
+  {
+    pthread_mutex_unlock (&intMutex) ;
+    return wiringPiFailure (WPI_ALMOST, "mcp23s17ISR: Interrupts not enabled for pin %d\n", pin) ;
+  }
+
+  intNode->callbacks [pin - intNode->node->pinBase] = function ;
+
+  pthread_mutex_unlock (&intMutex) ;
+  return 0 ;
+}
+
+
 /*
  * mcp23s17Setup:
  *	Create a new instance of an MCP23s17 SPI GPIO interface. We know it
@@ -229,6 +561,9 @@ int mcp23s17Setup (const int pinBase, const int spiPort, const int devId)
   node->pullUpDnControl = myPullUpDnControl ;
   node->digitalRead     = myDigitalRead ;
   node->digitalWrite    = myDigitalWrite ;
+  node->flush           = myFlush ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
   node->data2           = readByte (spiPort, devId, MCP23x17_OLATA) ;
   node->data3           = readByte (spiPort, devId, MCP23x17_OLATB) ;
 
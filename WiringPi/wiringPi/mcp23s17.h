@@ -28,6 +28,9 @@ extern "C" {
 
 extern int mcp23s17Setup (int pinBase, int spiPort, int devId) ;
 
+extern int mcp23s17EnableInterrupts (const int pinBase, const int hostIntPin, const int mask) ;
+extern int mcp23s17ISR              (const int pin, void (*function)(int pin, int value)) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -53,6 +53,23 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myAnalogReadEx:
+ *	10 bits, and we assume the usual 3.3v reference from the Pi
+ *********************************************************************************
+ */
+
+static int myAnalogReadEx (struct wiringPiNodeStruct *node, int pin, struct wpiSample *sample)
+{
+  wiringPiSampleSet (sample, myAnalogRead (node, pin), 10, 3.3 / 1024.0, 0.0, "V") ;
+
+  if (sample->raw == 0x3FF)
+    sample->flags |= WPI_SAMPLE_OVERRANGE ;
+
+  return 0 ;
+}
+
+
 /*
  * mcp3002Setup:
  *	Create a new wiringPi device node for an mcp3002 on the Pi's
@@ -69,8 +86,9 @@ int mcp3002Setup (const int pinBase, int spiChannel)
 
   node = wiringPiNewNode (pinBase, 2) ;
 
-  node->fd         = spiChannel ;
-  node->analogRead = myAnalogRead ;
+  node->fd           = spiChannel ;
+  node->analogRead   = myAnalogRead ;
+  node->analogReadEx = myAnalogReadEx ;
 
   return 0 ;
 }
@@ -53,6 +53,43 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myAnalogReadEx:
+ *	10 bits, and we assume the usual 3.3v reference from the Pi
+ *********************************************************************************
+ */
+
+static int myAnalogReadEx (struct wiringPiNodeStruct *node, int pin, struct wpiSample *sample)
+{
+  wiringPiSampleSet (sample, myAnalogRead (node, pin), 10, 3.3 / 1024.0, 0.0, "V") ;
+
+  if (sample->raw == 0x3FF)
+    sample->flags |= WPI_SAMPLE_OVERRANGE ;
+
+  return 0 ;
+}
+
+
+/*
+ * myAnalogReadMany:
+ *	Each conversion needs its own chip-select, but we can at least keep
+ *	the bus to ourselves so the scan isn't interleaved with anything else.
+ *********************************************************************************
+ */
+
+static int myAnalogReadMany (struct wiringPiNodeStruct *node, const int *chans, struct wpiSample *out, int n)
+{
+  int i ;
+
+  wiringPiSPILock (node->fd) ;
+    for (i = 0 ; i < n ; ++i)
+      myAnalogReadEx (node, node->pinBase + chans [i], &out [i]) ;
+  wiringPiSPIUnlock (node->fd) ;
+
+  return n ;
+}
+
+
 /*
  * mcp3004Setup:
  *	Create a new wiringPi device node for an mcp3004 on the Pi's
@@ -69,8 +106,10 @@ int mcp3004Setup (const int pinBase, int spiChannel)
 
   node = wiringPiNewNode (pinBase, 8) ;
 
-  node->fd         = spiChannel ;
-  node->analogRead = myAnalogRead ;
+  node->fd             = spiChannel ;
+  node->analogRead     = myAnalogRead ;
+  node->analogReadEx   = myAnalogReadEx ;
+  node->analogReadMany = myAnalogReadMany ;
 
   return 0 ;
 }
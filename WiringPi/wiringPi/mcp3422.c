@@ -36,56 +36,306 @@
 
 #include "mcp3422.h"
 
+#ifndef	TRUE
+#  define	TRUE	(1==1)
+#  define	FALSE	(1==2)
+#endif
+
+
+// Config register bits
+
+#define	MCP3422_RDY		0x80	// Write: start a conversion, Read: 0 when a new result is ready
+#define	MCP3422_CONTINUOUS	0x10
+
+// node->data2 holds our state: the channel we last started and the mode
+
+#define	STATE_CHAN		0x03
+#define	STATE_CONTINUOUS	0x10
+#define	STATE_SCANNING		0x20
+
+// Nominal conversion times in mS for each sample rate
+
+static const int convTime [4] = { 267, 67, 17, 5 } ;
+
 
 /*
- * myAnalogRead:
- *	Read a channel from the device
+ * startConversion:
+ *	Select the channel and either trigger a one-shot conversion or
+ *	start it converting continuously.
  *********************************************************************************
  */
 
-int myAnalogRead (struct wiringPiNodeStruct *node, int chan)
+static int startConversion (struct wiringPiNodeStruct *node, int chan, int continuous)
 {
   unsigned char config ;
+
+  config = (chan & 3) << 5 | (node->data0 << 2) | node->data1 ;
+  if (continuous)
+    config |= MCP3422_CONTINUOUS ;
+  else
+    config |= MCP3422_RDY ;
+
+  node->data2 = (node->data2 & STATE_SCANNING) | (chan & 3) | (continuous ? STATE_CONTINUOUS : 0) ;
+
+  return wiringPiI2CWrite (node->fd, config) ;
+}
+
+
+/*
+ * readResult:
+ *	Fetch the output register and its trailing config byte. Returns 1 with
+ *	the signed result if there's a new one, 0 if the conversion isn't
+ *	done yet, or -1 if the read failed.
+ *********************************************************************************
+ */
+
+static int readResult (struct wiringPiNodeStruct *node, int *value, int *bits)
+{
   unsigned char buffer [4] ;
-  int value = 0 ;
+  unsigned char config ;
+  int raw, ok ;
 
-// One-shot mode, trigger plus the other configs.
+  wiringPiI2CLock (node->fd) ;
+    if (node->data0 == MCP3422_SR_3_75)
+      ok = (read (node->fd, buffer, 4) == 4) ;
+    else
+      ok = (read (node->fd, buffer, 3) == 3) ;
+  wiringPiI2CUnlock (node->fd) ;
 
-  config = 0x80 | ((chan - node->pinBase) << 5) | (node->data0 << 2) | (node->data1) ;
-  
-  wiringPiI2CWrite (node->fd, config) ;
+  if (!ok)
+    return -1 ;
 
   switch (node->data0)	// Sample rate
   {
     case MCP3422_SR_3_75:			// 18 bits
-      delay (270) ;
-      read (node->fd, buffer, 4) ;
-      value = ((buffer [0] & 3) << 16) | (buffer [1] << 8) | buffer [0] ;
+      raw    = ((buffer [0] & 3) << 16) | (buffer [1] << 8) | buffer [2] ;
+      config = buffer [3] ;
+      *bits  = 18 ;
       break ;
 
     case MCP3422_SR_15:				// 16 bits
-      delay ( 70) ;
-      read (node->fd, buffer, 3) ;
-      value = (buffer [0] << 8) | buffer [1] ;
+      raw    = (buffer [0] << 8) | buffer [1] ;
+      config = buffer [2] ;
+      *bits  = 16 ;
       break ;
 
     case MCP3422_SR_60:				// 14 bits
-      delay ( 17) ;
-      read (node->fd, buffer, 3) ;
-      value = ((buffer [0] & 0x3F) << 8) | buffer [1] ;
+      raw    = ((buffer [0] & 0x3F) << 8) | buffer [1] ;
+      config = buffer [2] ;
+      *bits  = 14 ;
       break ;
 
-    case MCP3422_SR_240:			// 12 bits
-      delay (  5) ;
-      read (node->fd, buffer, 3) ;
-      value = ((buffer [0] & 0x0F) << 8) | buffer [0] ;
+    default:					// 12 bits
+      raw    = ((buffer [0] & 0x0F) << 8) | buffer [1] ;
+      config = buffer [2] ;
+      *bits  = 12 ;
       break ;
   }
 
+  if ((config & MCP3422_RDY) != 0)				// Not finished
+    return 0 ;
+
+  if (((config >> 5) & 3) != (node->data2 & STATE_CHAN))	// Stale - from another channel
+    return 0 ;
+
+// Results are two's complement
+
+  if ((raw & (1 << (*bits - 1))) != 0)
+    raw -= 1 << *bits ;
+
+  *value = raw ;
+
+  return 1 ;
+}
+
+
+/*
+ * convert:
+ *	Do a conversion and wait for it. We sleep for most of the nominal
+ *	conversion time, then poll the RDY bit rather than guess.
+ *	Readings are signed, so the result goes back via *value: returns 0
+ *	if we got one, -1 if the bus failed or the chip never finished.
+ *********************************************************************************
+ */
+
+static int convert (struct wiringPiNodeStruct *node, int chan, int *value, int *bits)
+{
+  int tries, x = 0 ;
+
+  *value = 0 ;
+  *bits  = 12 ;
+
+  if (startConversion (node, chan, FALSE) < 0)
+    return -1 ;
+
+  delay (convTime [node->data0 & 3] - convTime [node->data0 & 3] / 8) ;
+
+  for (tries = 0 ; tries < 100 ; ++tries)
+  {
+    if ((x = readResult (node, value, bits)) != 0)
+      break ;
+    delay (1) ;
+  }
+
+  return (x == 1) ? 0 : -1 ;
+}
+
+
+/*
+ * myAnalogRead:
+ *	Read a channel from the device. Any negative value is a valid
+ *	reading, so a failure just gives 0 here - use analogReadEx to
+ *	tell the difference.
+ *********************************************************************************
+ */
+
+static int myAnalogRead (struct wiringPiNodeStruct *node, int chan)
+{
+  int value, bits ;
+
+  if (convert (node, chan - node->pinBase, &value, &bits) < 0)
+    return 0 ;
+
   return value ;
 }
 
 
+/*
+ * myAnalogReadEx:
+ *	Full scale is +/- 2.048v, divided by the PGA gain. A failed
+ *	conversion is flagged WPI_SAMPLE_ERROR and returns -1.
+ *********************************************************************************
+ */
+
+static int myAnalogReadEx (struct wiringPiNodeStruct *node, int chan, struct wpiSample *sample)
+{
+  int bits = 12, raw ;
+
+  if (convert (node, chan - node->pinBase, &raw, &bits) < 0)
+  {
+    wiringPiSampleSet (sample, 0, 0, 1.0, 0.0, "") ;
+    sample->flags = WPI_SAMPLE_ERROR ;
+    return -1 ;
+  }
+
+  wiringPiSampleSet (sample, raw, bits, 2.048 / (double)(1 << (bits - 1)) / (double)(1 << node->data1), 0.0, "V") ;
+
+  if ((raw == (1 << (bits - 1)) - 1) || (raw == -(1 << (bits - 1))))
+    sample->flags |= WPI_SAMPLE_OVERRANGE ;
+
+  return 0 ;
+}
+
+
+/*
+ * mcp3422Start: mcp3422Continuous:
+ *	Start a conversion on the given pin without waiting for it, either
+ *	a single one or continuously. Use mcp3422Poll to collect results.
+ *********************************************************************************
+ */
+
+int mcp3422Start (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return -1 ;
+
+  node->data2 &= ~STATE_SCANNING ;
+  return startConversion (node, pin - node->pinBase, FALSE) ;
+}
+
+int mcp3422Continuous (int pin)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return -1 ;
+
+  node->data2 &= ~STATE_SCANNING ;
+  return startConversion (node, pin - node->pinBase, TRUE) ;
+}
+
+
+/*
+ * mcp3422Poll:
+ *	See if the conversion on the pin has finished. Returns 1 and the
+ *	value if it has, 0 if it's still going, -1 on error.
+ *	In continuous mode it returns 1 once for every new result.
+ *********************************************************************************
+ */
+
+int mcp3422Poll (int pin, int *value)
+{
+  struct wiringPiNodeStruct *node ;
+  int bits ;
+
+  if ((node = wiringPiFindNode (pin)) == NULL)
+    return -1 ;
+
+  if ((pin - node->pinBase) != (node->data2 & STATE_CHAN))
+    return -1 ;
+
+  return readResult (node, value, &bits) ;
+}
+
+
+/*
+ * mcp3422Scan: mcp3422ScanPoll:
+ *	Round-robin over the channels in chanMask (bit 0 is pinBase). Each
+ *	time a conversion finishes mcp3422ScanPoll stores it in values [chan],
+ *	starts the next channel and returns the bit of the channel updated,
+ *	so a thread can keep several ADCs busy without ever sleeping.
+ *	It returns 0 while the conversion is still going and -1 if the bus
+ *	fails, either reading the result or starting the next channel - the
+ *	scan needs restarting with mcp3422Scan then.
+ *********************************************************************************
+ */
+
+int mcp3422Scan (int pinBase, int chanMask)
+{
+  struct wiringPiNodeStruct *node ;
+  int chan ;
+
+  if (((node = wiringPiFindNode (pinBase)) == NULL) || ((chanMask & 0xF) == 0))
+    return -1 ;
+
+  node->data3  = chanMask & 0xF ;
+  node->data2 |= STATE_SCANNING ;
+
+  for (chan = 0 ; (node->data3 & (1 << chan)) == 0 ; ++chan)
+    ;
+
+  return startConversion (node, chan, FALSE) ;
+}
+
+int mcp3422ScanPoll (int pinBase, int *values)
+{
+  struct wiringPiNodeStruct *node ;
+  int chan, next, value, bits, x ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  if ((node->data2 & STATE_SCANNING) == 0)
+    return -1 ;
+
+  if ((x = readResult (node, &value, &bits)) <= 0)
+    return x ;
+
+  chan          = node->data2 & STATE_CHAN ;
+  values [chan] = value ;
+
+  for (next = (chan + 1) & 3 ; (node->data3 & (1 << next)) == 0 ; next = (next + 1) & 3)
+    ;
+
+  if (startConversion (node, next, FALSE) < 0)
+    return -1 ;
+
+  return 1 << chan ;
+}
+
+
 /*
  * mcp3422Setup:
  *	Create a new wiringPi device node for the mcp3422
@@ -102,9 +352,11 @@ int mcp3422Setup (int pinBase, int i2cAddress, int sampleRate, int gain)
 
   node = wiringPiNewNode (pinBase, 4) ;
 
-  node->data0      = sampleRate ;
-  node->data1      = gain ;
-  node->analogRead = myAnalogRead ;
+  node->fd           = fd ;
+  node->data0        = sampleRate & 3 ;
+  node->data1        = gain & 3 ;
+  node->analogRead   = myAnalogRead ;
+  node->analogReadEx = myAnalogReadEx ;
 
   return 0 ;
 }
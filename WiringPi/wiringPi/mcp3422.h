@@ -38,6 +38,12 @@ extern "C" {
 
 extern int mcp3422Setup (int pinBase, int i2cAddress, int sampleRate, int gain) ;
 
+extern int mcp3422Start      (int pin) ;
+extern int mcp3422Continuous (int pin) ;
+extern int mcp3422Poll       (int pin, int *value) ;
+extern int mcp3422Scan       (int pinBase, int chanMask) ;
+extern int mcp3422ScanPoll   (int pinBase, int *values) ;
+
 #ifdef __cplusplus
 }
 #endif
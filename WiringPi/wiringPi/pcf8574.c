@@ -43,6 +43,8 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
   int bit, old ;
 
+  wiringPiI2CLock (node->fd) ;
+
   bit  = 1 << ((pin - node->pinBase) & 7) ;
 
   old = node->data2 ;
@@ -53,6 +55,9 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 
   wiringPiI2CWrite (node->fd, old) ;
   node->data2 = old ;
+  node->dirty = 0 ;	// Any deferred writes just went out with it
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -66,6 +71,8 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
   int bit, old ;
 
+  wiringPiI2CLock (node->fd) ;
+
   bit  = 1 << ((pin - node->pinBase) & 7) ;
 
   old = node->data2 ;
@@ -74,8 +81,29 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
   else
     old |=   bit ;
 
-  wiringPiI2CWrite (node->fd, old) ;
   node->data2 = old ;
+
+  if (node->deferred)
+    node->dirty = 1 ;
+  else
+    wiringPiI2CWrite (node->fd, old) ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
+/*
+ * myFlush:
+ *	Only the one port, so just write the shadow out
+ *********************************************************************************
+ */
+
+static void myFlush (struct wiringPiNodeStruct *node)
+{
+  wiringPiI2CLock (node->fd) ;
+    wiringPiI2CWrite (node->fd, node->data2) ;
+    node->dirty = 0 ;
+  wiringPiI2CUnlock (node->fd) ;
 }
 
 
@@ -98,6 +126,33 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	The PCF8574 only ever transfers the whole port anyway. Remember
+ *	that pins used as inputs need to be kept written high.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  return wiringPiI2CRead (node->fd) & 0xFF ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  wiringPiI2CLock (node->fd) ;
+
+  node->data2 = (node->data2 & ~mask) | (value & mask & 0xFF) ;
+
+  if (node->deferred)
+    node->dirty = 1 ;
+  else
+    wiringPiI2CWrite (node->fd, node->data2) ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
 /*
  * pcf8574Setup:
  *	Create a new instance of a PCF8574 I2C GPIO interface. We know it
@@ -116,11 +171,14 @@ int pcf8574Setup (const int pinBase, const int i2cAddress)
 
   node = wiringPiNewNode (pinBase, 8) ;
 
-  node->fd           = fd ;
-  node->pinMode      = myPinMode ;
-  node->digitalRead  = myDigitalRead ;
-  node->digitalWrite = myDigitalWrite ;
-  node->data2        = wiringPiI2CRead (fd) ;
+  node->fd               = fd ;
+  node->pinMode          = myPinMode ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->flush            = myFlush ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
+  node->data2            = wiringPiI2CRead (fd) ;
 
   return 0 ;
 }
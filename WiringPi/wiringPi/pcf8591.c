@@ -63,6 +63,54 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myAnalogReadEx:
+ *	8 bits, assuming the reference is tied to the Pi's 3.3v
+ *********************************************************************************
+ */
+
+static int myAnalogReadEx (struct wiringPiNodeStruct *node, int pin, struct wpiSample *sample)
+{
+  wiringPiSampleSet (sample, myAnalogRead (node, pin), 8, 3.3 / 256.0, 0.0, "V") ;
+
+  if (sample->raw == 0xFF)
+    sample->flags |= WPI_SAMPLE_OVERRANGE ;
+
+  return 0 ;
+}
+
+
+/*
+ * myAnalogReadMany:
+ *	Use the chip's auto-increment mode to convert all 4 channels in
+ *	one read. Each byte is the result of the previous conversion, so
+ *	the first one is thrown away.
+ *********************************************************************************
+ */
+
+static int myAnalogReadMany (struct wiringPiNodeStruct *node, const int *chans, struct wpiSample *out, int n)
+{
+  unsigned char b [5] = { 0, 0, 0, 0, 0 } ;
+  int i, ok ;
+
+  wiringPiI2CLock (node->fd) ;
+    wiringPiI2CWrite (node->fd, 0x44) ;		// Output enabled, auto-increment from 0
+    ok = (read (node->fd, b, 5) == 5) ;
+  wiringPiI2CUnlock (node->fd) ;
+
+  for (i = 0 ; i < n ; ++i)
+  {
+    wiringPiSampleSet (&out [i], b [1 + (chans [i] & 3)], 8, 3.3 / 256.0, 0.0, "V") ;
+    if (!ok)
+      out [i].flags |= WPI_SAMPLE_ERROR ;
+    else if (out [i].raw == 0xFF)
+      out [i].flags |= WPI_SAMPLE_OVERRANGE ;
+  }
+
+  return ok ? n : -1 ;
+}
+
+
 /*
  * pcf8591Setup:
  *	Create a new instance of a PCF8591 I2C GPIO interface. We know it
@@ -82,9 +130,11 @@ int pcf8591Setup (const int pinBase, const int i2cAddress)
 
   node = wiringPiNewNode (pinBase, 4) ;
 
-  node->fd          = fd ;
-  node->analogRead  = myAnalogRead ;
-  node->analogWrite = myAnalogWrite ;
+  node->fd             = fd ;
+  node->analogRead     = myAnalogRead ;
+  node->analogWrite    = myAnalogWrite ;
+  node->analogReadEx   = myAnalogReadEx ;
+  node->analogReadMany = myAnalogReadMany ;
 
   return 0 ;
 }
@@ -22,26 +22,140 @@
  ***********************************************************************
  */
 
+#include <stdio.h>
+
 #include <wiringPi.h>
 #include <wiringPiI2C.h>
 
 #include "sn3218.h"
 
+// Shadow of the 18 PWM registers
+//	The chip is on a fixed I2C address, so there can only be the one.
+//	The registers are write-only, so we also keep track of which ones
+//	we've changed and not sent yet - a flush only sends those, leaving
+//	anything set before we started alone.
+
+static uint8_t      pwmValues [18] ;
+static unsigned int pwmDirty ;
+
+
+/*
+ * writeAll:
+ *	Take the new values into the shadow and send all 18 PWM
+ *	registers in one block write, then one write to the update register
+ *	to make them take effect together. The shadow's only touched under
+ *	the bus lock, the same as myAnalogWrite does.
+ *********************************************************************************
+ */
+
+static int writeAll (struct wiringPiNodeStruct *node, const uint8_t *vals)
+{
+  int result, i ;
+
+  wiringPiI2CLock (node->fd) ;
+    for (i = 0 ; i < 18 ; ++i)
+      pwmValues [i] = vals [i] ;
+
+    if ((result = wiringPiI2CWriteBlock (node->fd, 0x01, pwmValues, 18)) >= 0)
+      result = wiringPiI2CWriteReg8 (node->fd, 0x16, 0x00) ;	// Update
+    pwmDirty    = 0 ;
+    node->dirty = 0 ;
+  wiringPiI2CUnlock (node->fd) ;
+
+  return result ;
+}
+
+
+/*
+ * writeChanged:
+ *	Send each run of changed PWM registers as a block write, then the
+ *	one write to the update register for them all.
+ *********************************************************************************
+ */
+
+static void writeChanged (struct wiringPiNodeStruct *node)
+{
+  int first, last ;
+
+  wiringPiI2CLock (node->fd) ;
+
+  for (first = 0 ; first < 18 ; first = last)
+  {
+    if ((pwmDirty & (1U << first)) == 0)
+    {
+      last = first + 1 ;
+      continue ;
+    }
+
+    for (last = first + 1 ; (last < 18) && ((pwmDirty & (1U << last)) != 0) ; ++last)
+      ;
+
+    wiringPiI2CWriteBlock (node->fd, 0x01 + first, &pwmValues [first], last - first) ;
+  }
+
+  if (pwmDirty != 0)
+    wiringPiI2CWriteReg8 (node->fd, 0x16, 0x00) ;	// Update
+
+  pwmDirty    = 0 ;
+  node->dirty = 0 ;
+
+  wiringPiI2CUnlock (node->fd) ;
+}
+
+
 /*
  * myAnalogWrite:
- *	Write analog value on the given pin
+ *	Write analog value on the given pin. While the node is deferred
+ *	we just remember it and send the lot when it's flushed.
  *********************************************************************************
  */
 
 static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  int fd   = node->fd ;
-  int chan = 0x01 + (pin - node->pinBase) ;
-  
-  wiringPiI2CWriteReg8 (fd, chan, value & 0xFF) ;	// Value
-  wiringPiI2CWriteReg8 (fd, 0x16, 0x00) ;		// Update
+  int chan = pin - node->pinBase ;
+
+  wiringPiI2CLock (node->fd) ;
+
+  pwmValues [chan] = value & 0xFF ;
+  pwmDirty        |= 1U << chan ;
+
+  if (node->deferred)
+    node->dirty = 1 ;
+  else
+    writeChanged (node) ;
+
+  wiringPiI2CUnlock (node->fd) ;
 }
 
+
+/*
+ * myFlush:
+ *********************************************************************************
+ */
+
+static void myFlush (struct wiringPiNodeStruct *node)
+{
+  writeChanged (node) ;
+}
+
+
+/*
+ * sn3218WriteAll:
+ *	Set all 18 LEDs at once - a whole frame in two I2C transfers
+ *********************************************************************************
+ */
+
+int sn3218WriteAll (const int pinBase, const uint8_t vals [18])
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  return writeAll (node, vals) ;
+}
+
+
 /*
  * sn3218Setup:
  *	Create a new wiringPi device node for an sn3218 on the Pi's
@@ -70,6 +184,7 @@ int sn3218Setup (const int pinBase)
 
   node->fd          = fd ;
   node->analogWrite = myAnalogWrite ;
+  node->flush       = myFlush ;
 
   return 0 ;
 }
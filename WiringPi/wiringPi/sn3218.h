@@ -22,11 +22,16 @@
  ***********************************************************************
  */
 
+#ifndef	_STDINT_H
+#  include <stdint.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-extern int sn3218Setup (int pinBase) ;
+extern int sn3218Setup    (int pinBase) ;
+extern int sn3218WriteAll (const int pinBase, const uint8_t vals [18]) ;
 
 #ifdef __cplusplus
 }
@@ -28,13 +28,99 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "wiringPi.h"
+#include "wiringShift.h"
 
 #include "sr595.h"
 
 
+// The chain's clock rate. The 74HC595 is good for much more than this
+//	at 3.3v, but it leaves some margin for long wires between chips.
+
+#define	SR595_CLOCK	2000000
+
+// Per-node output register
+//	Bit n of output [] is pin pinBase + n, so the chain can be as long
+//	as you like. tx [] is the same thing reversed for shifting out.
+
+struct sr595Struct
+{
+  struct wiringPiNodeStruct *node ;
+  int      bytes ;
+  uint8_t *output ;
+  uint8_t *tx ;
+
+  struct sr595Struct *next ;
+} ;
+
+static struct sr595Struct *sr595Nodes = NULL ;
+
+
+/*
+ * findSr595:
+ *	Locate the output register for a node
+ *********************************************************************************
+ */
+
+static struct sr595Struct *findSr595 (struct wiringPiNodeStruct *node)
+{
+  struct sr595Struct *sr ;
+
+  for (sr = sr595Nodes ; sr != NULL ; sr = sr->next)
+    if (sr->node == node)
+      return sr ;
+
+  return NULL ;
+}
+
+
+/*
+ * shiftChain:
+ *	Clock the whole output register out to the chain and latch it.
+ *	The last pin goes out first. If the number of pins isn't a multiple
+ *	of 8 the spare bits go out first too, so they fall off the far end.
+ *********************************************************************************
+ */
+
+static void shiftChain (struct wiringPiNodeStruct *node)
+{
+  struct sr595Struct *sr = findSr595 (node) ;
+  int  latchPin, i ;
+
+  latchPin = node->data2 ;
+
+  for (i = 0 ; i < sr->bytes ; ++i)
+    sr->tx [i] = sr->output [sr->bytes - 1 - i] ;
+
+// A low -> high latch transition copies the latch to the output pins
+
+  digitalWrite (latchPin, LOW) ;
+    shiftOutBuf (node->data0, node->data1, MSBFIRST, sr->tx, sr->bytes, SR595_CLOCK) ;
+  digitalWrite (latchPin, HIGH) ;
+
+  node->dirty = 0 ;
+}
+
+
+/*
+ * update:
+ *	Latch the new outputs now, or remember to when the node's flushed
+ *********************************************************************************
+ */
+
+static void update (struct wiringPiNodeStruct *node)
+{
+  if (node->deferred)
+    node->dirty = 1 ;
+  else
+    shiftChain (node) ;
+}
+
+
 /*
  * myDigitalWrite:
  *********************************************************************************
@@ -42,37 +128,98 @@
 
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  unsigned int mask ;
-  int  dataPin, clockPin, latchPin ;
-  int  bit, bits, output ;
-
-  pin     -= node->pinBase ;				// Normalise pin number
-  bits     = node->pinMax - node->pinBase + 1 ;		// ie. number of clock pulses
-  dataPin  = node->data0 ;
-  clockPin = node->data1 ;
-  latchPin = node->data2 ;
-  output   = node->data3 ;
+  struct sr595Struct *sr = findSr595 (node) ;
+  uint8_t mask ;
+
+  pin -= node->pinBase ;				// Normalise pin number
 
-  mask = 1 << pin ;
+  mask = 1 << (pin & 7) ;
 
   if (value == LOW)
-    output &= (~mask) ;
+    sr->output [pin >> 3] &= (~mask) ;
   else
-    output |=   mask ;
+    sr->output [pin >> 3] |=   mask ;
 
-  node->data3 = output ;
+  update (node) ;
+}
 
-// A low -> high latch transition copies the latch to the output pins
 
-  digitalWrite (latchPin, LOW) ; delayMicroseconds (1) ;
-    for (bit = bits - 1 ; bit >= 0 ; --bit)
-    {
-      digitalWrite (dataPin, output & (1 << bit)) ;
+/*
+ * myFlush:
+ *	One shift and latch for everything written while deferred
+ *********************************************************************************
+ */
 
-      digitalWrite (clockPin, HIGH) ; delayMicroseconds (1) ;
-      digitalWrite (clockPin, LOW) ;  delayMicroseconds (1) ;
-    }
-  digitalWrite (latchPin, HIGH) ; delayMicroseconds (1) ;
+static void myFlush (struct wiringPiNodeStruct *node)
+{
+  shiftChain (node) ;
+}
+
+
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	There's nothing to read back from a '595, so return what we last
+ *	wrote. A port write changes any number of the first 32 outputs
+ *	with one shift.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node)
+{
+  struct sr595Struct *sr = findSr595 (node) ;
+  unsigned int value = 0 ;
+  int i ;
+
+  for (i = 0 ; (i < sr->bytes) && (i < 4) ; ++i)
+    value |= (unsigned int)sr->output [i] << (i * 8) ;
+
+  return value ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  struct sr595Struct *sr = findSr595 (node) ;
+  int i ;
+
+  for (i = 0 ; (i < sr->bytes) && (i < 4) ; ++i)
+    sr->output [i] = (sr->output [i] & ~(mask >> (i * 8))) | ((value & mask) >> (i * 8)) ;
+
+  update (node) ;
+}
+
+
+/*
+ * sr595Write:
+ *	Set a whole run of outputs from a buffer - bit 0 of bits [0] is
+ *	pinBase, bit 0 of bits [1] is pinBase + 8 and so on, for len bytes.
+ *	Goes out with a single shift (or none, if the node is deferred).
+ *********************************************************************************
+ */
+
+int sr595Write (const int pinBase, const uint8_t *bits, int len)
+{
+  struct wiringPiNodeStruct *node ;
+  struct sr595Struct *sr ;
+  int numPins ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  if ((sr = findSr595 (node)) == NULL)
+    return -1 ;
+
+  if (len > sr->bytes)
+    len = sr->bytes ;
+
+  memcpy (sr->output, bits, len) ;
+
+  numPins = node->pinMax - node->pinBase + 1 ;
+  if ((numPins & 7) != 0)
+    sr->output [sr->bytes - 1] &= (1 << (numPins & 7)) - 1 ;
+
+  update (node) ;
+
+  return 0 ;
 }
 
 
@@ -86,14 +233,33 @@ int sr595Setup (const int pinBase, const int numPins,
 	const int dataPin, const int clockPin, const int latchPin) 
 {
   struct wiringPiNodeStruct *node ;
+  struct sr595Struct *sr ;
+  int bytes = (numPins + 7) / 8 ;
+
+  if ((sr = (struct sr595Struct *)calloc (1, sizeof (struct sr595Struct))) == NULL)
+    return -1 ;
+
+  if ((sr->output = (uint8_t *)calloc (2, bytes)) == NULL)
+  {
+    free (sr) ;
+    return -1 ;
+  }
 
   node = wiringPiNewNode (pinBase, numPins) ;
 
-  node->data0           = dataPin ;
-  node->data1           = clockPin ;
-  node->data2           = latchPin ;
-  node->data3           = 0 ;		// Output register
-  node->digitalWrite    = myDigitalWrite ;
+  sr->node   = node ;
+  sr->bytes  = bytes ;
+  sr->tx     = sr->output + bytes ;
+  sr->next   = sr595Nodes ;
+  sr595Nodes = sr ;
+
+  node->data0            = dataPin ;
+  node->data1            = clockPin ;
+  node->data2            = latchPin ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->flush            = myFlush ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
 
 // Initialise the underlying hardware
 
@@ -22,6 +22,10 @@
  ***********************************************************************
  */
 
+#ifndef	_STDINT_H
+#  include <stdint.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,6 +33,8 @@ extern "C" {
 extern int sr595Setup (const int pinBase, const int numPins,
 	const int dataPin, const int clockPin, const int latchPin) ;
 
+extern int sr595Write (const int pinBase, const uint8_t *bits, int len) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -69,6 +69,8 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/gpio.h>
 
 #include "softPwm.h"
 #include "softTone.h"
@@ -187,11 +189,17 @@ static volatile unsigned int	 BCM2708_PERI_BASE = 0x20000000 ;	// Variable for P
 
 // Locals to hold pointers to the hardware
 
+//	The GPIO block is mapped by wiringPiSetup, the others only when
+//	something first needs them - see mapBlock ()
+
 static volatile uint32_t *gpio ;
 static volatile uint32_t *pwm ;
 static volatile uint32_t *clk ;
 static volatile uint32_t *pads ;
 
+static int memFd   = -1 ;
+static int gpioMem = FALSE ;	// Using /dev/gpiomem - only the GPIO block
+
 #ifdef	USE_TIMER
 static volatile uint32_t *timer ;
 static volatile uint32_t *timerIrqRaw ;
@@ -205,6 +213,22 @@ static volatile uint32_t *timerIrqRaw ;
 
 static int piModel2 = FALSE ;
 
+// The board we're running on
+//	Worked out once by readBoard () and kept for everyone else.
+
+struct piBoardStruct
+{
+  int           state ;		// 0 not read yet, 1 OK, -1 unable to tell
+  const char   *why ;		// Why not, if not
+  int           boardRev ;	// As piBoardRev ()
+  int           model, rev, mem, maker, overVolted ;
+  unsigned int  periBase ;
+  int          *pinToGpio ;
+  int          *physToGpio ;
+} ;
+
+static struct piBoardStruct piBoard = { 0 } ;
+
 const char *piModelNames [7] =
 {
   "Unknown",
@@ -252,6 +276,10 @@ int wiringPiReturnCodes = FALSE ;
 
 // sysFds:
 //	Map a file descriptor from the /sys/class/gpio/gpioX/value
+//	-1 if we've not tried it yet, SYS_FD_MISSING if it wasn't there
+//	(until the next wiringPiSetupSys or wiringPiISR)
+
+#define	SYS_FD_MISSING	(-2)
 
 static int sysFds [64] =
 {
@@ -261,9 +289,42 @@ static int sysFds [64] =
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 } ;
 
+// GPIO character device:
+//	chipFd is the /dev/gpiochipN we're using. Each pin gets a line handle
+//	when it's first used, or an event handle when it's used for edges.
+//	chipMutex and chipCond look after swapping a pin's event handle
+//	while waitForEdge may be polling it.
+
+static int chipFd    = -1 ;
+static int chipLines =  0 ;
+static int chipHandles [64] ;
+static int chipOutput  [64] ;		// The handle is an output
+static int chipValue   [64] ;		// What we last wrote to it
+static int chipBias    [64] ;
+static int chipEvents  [64] ;
+static int chipEdges   [64] ;		// INT_EDGE_xxx it's watched for
+static int chipWake    [64] ;		// eventfd to kick waitForEdge out of poll
+static int chipWaiters [64] ;
+static int chipBusy    [64] ;		// Event handle being swapped
+
+static pthread_mutex_t chipMutex = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  chipCond  = PTHREAD_COND_INITIALIZER ;
+
+// The one multi-line handle for digitalReadMany/WriteMany
+
+static struct
+{
+  int fd, output, count ;
+  int pins [32] ;
+} chipGroup = { -1, FALSE, 0, { 0 } } ;
+
 // ISR Data
+//	One thread per pin, remembered so wiringPiTeardown can stop it.
 
 static void (*isrFunctions [64])(void) ;
+static pthread_t isrThreads [64] ;
+static int       isrRunning [64] ;
+static volatile int isrExited [64] ;	// Thread gave up - join it before another
 
 
 // Doing it the Arduino way with lookup tables...
@@ -601,6 +662,39 @@ int wiringPiFailure (int fatal, const char *message, ...)
 }
 
 
+/*
+ * mapBlock:
+ *	Map one of the peripheral blocks, if we've not already done so.
+ *	Returns FALSE if we can't - e.g. we're not root and only have
+ *	/dev/gpiomem.
+ *********************************************************************************
+ */
+
+static int mapBlock (volatile uint32_t **block, unsigned int base, const char *what)
+{
+  void *map ;
+
+  if (*block != NULL)
+    return TRUE ;
+
+  if ((memFd == -1) || gpioMem)
+  {
+    (void)wiringPiFailure (WPI_ALMOST, "wiringPi: Unable to access the %s registers. Must be root. (Did you forget sudo?)\n", what) ;
+    return FALSE ;
+  }
+
+  if ((map = mmap (0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, memFd, base)) == MAP_FAILED)
+  {
+    (void)wiringPiFailure (WPI_ALMOST, "wiringPi: mmap (%s) failed: %s\n", what, strerror (errno)) ;
+    return FALSE ;
+  }
+
+  *block = (volatile uint32_t *)map ;
+
+  return TRUE ;
+}
+
+
 /*
  * piBoardRev:
  *	Return a number representing the hardware revision of the board.
@@ -644,94 +738,221 @@ int wiringPiFailure (int fatal, const char *message, ...)
  *********************************************************************************
  */
 
-static void piBoardRevOops (const char *why)
+/*
+ * readDtModel:
+ *	See what the device tree says we are - for when /proc/cpuinfo
+ *	doesn't say BCM2708 or BCM2709. Returns 2 for a Pi 2, 1 for
+ *	an original (BCM2835) Pi, -1 for a newer Pi we don't know the
+ *	peripheral base of, 0 if it's not a Pi at all.
+ *********************************************************************************
+ */
+
+static int readDtModel (void)
 {
-  fprintf (stderr, "piBoardRev: Unable to determine board revision from /proc/cpuinfo\n") ;
-  fprintf (stderr, " -> %s\n", why) ;
-  fprintf (stderr, " ->  You may want to check:\n") ;
-  fprintf (stderr, " ->  http://www.raspberrypi.org/phpBB3/viewtopic.php?p=184410#p184410\n") ;
-  exit (EXIT_FAILURE) ;
+  FILE *fd ;
+  char model [120] ;
+
+  if ((fd = fopen ("/proc/device-tree/model", "r")) == NULL)
+    return 0 ;
+
+  if (fgets (model, 120, fd) == NULL)
+    model [0] = 0 ;
+  fclose (fd) ;
+
+  if (wiringPiDebug)
+    printf ("piBoardRev: Device tree model: %s\n", model) ;
+
+  if (strncmp (model, "Raspberry Pi", 12) != 0)
+    return 0 ;
+
+  if (strncmp (model, "Raspberry Pi 2", 14) == 0)
+    return 2 ;
+
+  if ((strncmp (model, "Raspberry Pi Model ", 19) == 0) ||
+      (strncmp (model, "Raspberry Pi Compute Module Rev", 31) == 0) ||
+      ((strncmp (model, "Raspberry Pi Zero", 17) == 0) && (strncmp (model, "Raspberry Pi Zero 2", 19) != 0)))
+    return 1 ;
+
+  return -1 ;
 }
 
-int piBoardRev (void)
+
+/*
+ * readDtPeriBase:
+ *	The device tree knows where the peripherals are; use that if we
+ *	can as it's more reliable than guessing from the model.
+ *	The first soc/ranges entry is <bus address> <cpu address> in
+ *	big-endian cells: one cell each on the older chips, but the BCM2711
+ *	has a two-cell CPU address with the high word (0) first.
+ *	Returns 0 if we can't make sense of it.
+ *********************************************************************************
+ */
+
+static unsigned int readDtCell (const unsigned char *cell)
+{
+  return ((unsigned int)cell [0] << 24) | (cell [1] << 16) | (cell [2] << 8) | cell [3] ;
+}
+
+static unsigned int readDtPeriBase (void)
+{
+  FILE *fd ;
+  unsigned char ranges [12] ;
+  unsigned int base = 0 ;
+  size_t n ;
+
+  if ((fd = fopen ("/proc/device-tree/soc/ranges", "rb")) == NULL)
+    return 0 ;
+
+  n = fread (ranges, 1, 12, fd) ;
+  fclose (fd) ;
+
+  if (n >= 8)
+    base = readDtCell (&ranges [4]) ;
+
+  if ((base == 0) && (n == 12))			// Two-cell CPU address
+    base = readDtCell (&ranges [8]) ;
+
+  if (base == 0xFFFFFFFF)
+    return 0 ;
+
+  return base ;
+}
+
+
+/*
+ * readRevision:
+ *	Decode the last 4 digits of the revision string for the original
+ *	boards. Returns FALSE if we don't recognise it.
+ *********************************************************************************
+ */
+
+static int readRevision (const char *c, struct piBoardStruct *b)
+{
+  /**/ if (strcmp (c, "0002") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_1   ; b->mem = 256 ; b->maker = PI_MAKER_EGOMAN ; }
+  else if (strcmp (c, "0003") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_1_1 ; b->mem = 256 ; b->maker = PI_MAKER_EGOMAN ; }
+  else if (strcmp (c, "0004") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 256 ; b->maker = PI_MAKER_SONY   ; }
+  else if (strcmp (c, "0005") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 256 ; b->maker = PI_MAKER_QISDA  ; }
+  else if (strcmp (c, "0006") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 256 ; b->maker = PI_MAKER_EGOMAN ; }
+  else if (strcmp (c, "0007") == 0) { b->model = PI_MODEL_A  ; b->rev = PI_VERSION_2   ; b->mem = 256 ; b->maker = PI_MAKER_EGOMAN ; }
+  else if (strcmp (c, "0008") == 0) { b->model = PI_MODEL_A  ; b->rev = PI_VERSION_2   ; b->mem = 256 ; b->maker = PI_MAKER_SONY   ; }
+  else if (strcmp (c, "0009") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 256 ; b->maker = PI_MAKER_QISDA  ; }
+  else if (strcmp (c, "000d") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 512 ; b->maker = PI_MAKER_EGOMAN ; }
+  else if (strcmp (c, "000e") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 512 ; b->maker = PI_MAKER_SONY   ; }
+  else if (strcmp (c, "000f") == 0) { b->model = PI_MODEL_B  ; b->rev = PI_VERSION_2   ; b->mem = 512 ; b->maker = PI_MAKER_EGOMAN ; }
+  else if (strcmp (c, "0010") == 0) { b->model = PI_MODEL_BP ; b->rev = PI_VERSION_1_2 ; b->mem = 512 ; b->maker = PI_MAKER_SONY   ; }
+  else if (strcmp (c, "0011") == 0) { b->model = PI_MODEL_CM ; b->rev = PI_VERSION_1_2 ; b->mem = 512 ; b->maker = PI_MAKER_SONY   ; }
+  else if (strcmp (c, "0012") == 0) { b->model = PI_MODEL_AP ; b->rev = PI_VERSION_1_2 ; b->mem = 256 ; b->maker = PI_MAKER_SONY   ; }
+  else if (strcmp (c, "0013") == 0) { b->model = PI_MODEL_BP ; b->rev = PI_VERSION_1_2 ; b->mem = 512 ; b->maker = PI_MAKER_MBEST  ; }
+  else if (strcmp (c, "0014") == 0) { b->model = PI_MODEL_CM ; b->rev = PI_VERSION_1_2 ; b->mem = 512 ; b->maker = PI_MAKER_SONY   ; }
+  else                              { b->model = 0           ; b->rev = 0              ; b->mem =   0 ; b->maker = 0 ; return FALSE ; }
+
+  return TRUE ;
+}
+
+
+/*
+ * readBoard:
+ *	Read /proc/cpuinfo (and the device tree if need be) the once and
+ *	fill in piBoard with everything we need to know about the board.
+ *	Returns 0 if OK, or -1 with piBoard.why set if we can't tell what
+ *	we're running on.
+ *********************************************************************************
+ */
+
+static int readBoard (void)
 {
   FILE *cpuFd ;
-  char line [120] ;
+  char line [120], hardware [120], revision [120] ;
   char *c ;
-  static int  boardRev = -1 ;
+  int  dtModel ;
+  int  known = TRUE ;		// We know where its peripherals should be
+  struct piBoardStruct *b = &piBoard ;
 
-  if (boardRev != -1)	// No point checking twice
-    return boardRev ;
+  if (b->state != 0)	// No point checking twice
+    return (b->state == 1) ? 0 : -1 ;
+
+  b->state = -1 ;
 
   if ((cpuFd = fopen ("/proc/cpuinfo", "r")) == NULL)
-    piBoardRevOops ("Unable to open /proc/cpuinfo") ;
+  {
+    b->why = "Unable to open /proc/cpuinfo" ;
+    return -1 ;
+  }
 
-// Start by looking for the Architecture, then we can look for a B2 revision....
+  hardware [0] = revision [0] = 0 ;
 
   while (fgets (line, 120, cpuFd) != NULL)
-    if (strncmp (line, "Hardware", 8) == 0)
-      break ;
+    /**/ if (strncmp (line, "Hardware", 8) == 0)
+      strcpy (hardware, line) ;
+    else if (strncmp (line, "Revision", 8) == 0)
+      strcpy (revision, line) ;
 
-  if (strncmp (line, "Hardware", 8) != 0)
-    piBoardRevOops ("No \"Hardware\" line") ;
+  fclose (cpuFd) ;
 
   if (wiringPiDebug)
-    printf ("piboardRev: Hardware: %s\n", line) ;
+    printf ("piboardRev: Hardware: %s\n", hardware) ;
 
-// See if it's BCM2708 or BCM2709
+// See if it's BCM2708 or BCM2709. Newer kernels may say something else
+//	entirely, so then ask the device tree.
 
-  if (strstr (line, "BCM2709") != NULL)
+  /**/ if (strstr (hardware, "BCM2709") != NULL)
     piModel2 = TRUE ;
-  else if (strstr (line, "BCM2708") == NULL)
+  else if (strstr (hardware, "BCM2708") != NULL)
+    piModel2 = FALSE ;
+  else if ((dtModel = readDtModel ()) != 0)
   {
-    fprintf (stderr, "Unable to determine hardware version. I see: %s,\n", line) ;
-    fprintf (stderr, " - expecting BCM2708 or BCM2709. Please report this to projects@drogon.net\n") ;
-    exit (EXIT_FAILURE) ;
+    piModel2 = (dtModel == 2) ;
+    known    = (dtModel != -1) ;
+  }
+  else
+  {
+    b->why = (hardware [0] == 0) ? "No \"Hardware\" line" : "Unknown hardware - expecting BCM2708 or BCM2709" ;
+    return -1 ;
   }
 
-// Now do the rest of it as before
-
-  rewind (cpuFd) ;
-
-  while (fgets (line, 120, cpuFd) != NULL)
-    if (strncmp (line, "Revision", 8) == 0)
-      break ;
-
-  fclose (cpuFd) ;
-
-  if (strncmp (line, "Revision", 8) != 0)
-    piBoardRevOops ("No \"Revision\" line") ;
+  if (revision [0] == 0)
+  {
+    b->why = "No \"Revision\" line" ;
+    return -1 ;
+  }
 
 // Chomp trailing CR/NL
 
-  for (c = &line [strlen (line) - 1] ; (*c == '\n') || (*c == '\r') ; --c)
+  for (c = &revision [strlen (revision) - 1] ; (c >= revision) && ((*c == '\n') || (*c == '\r')) ; --c)
     *c = 0 ;
-  
+
   if (wiringPiDebug)
-    printf ("piboardRev: Revision string: %s\n", line) ;
+    printf ("piboardRev: Revision string: %s\n", revision) ;
 
 // Scan to first digit
 
-  for (c = line ; *c ; ++c)
+  for (c = revision ; *c ; ++c)
     if (isdigit (*c))
       break ;
 
   if (!isdigit (*c))
-    piBoardRevOops ("No numeric revision string") ;
+  {
+    b->why = "No numeric revision string" ;
+    return -1 ;
+  }
 
 // Make sure its long enough
 
   if (strlen (c) < 4)
-    piBoardRevOops ("Bogus \"Revision\" line (too small)") ;
-  
+  {
+    b->why = "Bogus \"Revision\" line (too small)" ;
+    return -1 ;
+  }
+
 // If you have overvolted the Pi, then it appears that the revision
 //	has 100000 added to it!
 // The actual condition for it being set is:
 //	 (force_turbo || current_limit_override || temp_limit>85) && over_voltage>0
 
-  if (wiringPiDebug)
-    if (strlen (c) != 4)
-      printf ("piboardRev: This Pi has/is (force_turbo || current_limit_override || temp_limit>85) && over_voltage>0\n") ;
+  b->overVolted = strlen (c) > 4 ;
+
+  if (wiringPiDebug && b->overVolted)
+    printf ("piboardRev: This Pi has/is (force_turbo || current_limit_override || temp_limit>85) && over_voltage>0\n") ;
 
 // Isolate  last 4 characters:
 
@@ -741,14 +962,85 @@ int piBoardRev (void)
     printf ("piboardRev: last4Chars are: \"%s\"\n", c) ;
 
   if ( (strcmp (c, "0002") == 0) || (strcmp (c, "0003") == 0))
-    boardRev = 1 ;
+    b->boardRev = 1 ;
+  else
+    b->boardRev = 2 ;	// Covers everything else from the B revision 2 to the B+, the Pi v2 and CM's.
+
+//	Will deal with the new style revision codes properly later on...
+
+  if (piModel2)
+  {
+    b->model      = PI_MODEL_2  ;
+    b->rev        = PI_VERSION_1_1 ;
+    b->mem        = 1024 ;
+    b->maker      = PI_MAKER_SONY   ;
+    b->overVolted = FALSE ;
+  }
   else
-    boardRev = 2 ;	// Covers everything else from the B revision 2 to the B+, the Pi v2 and CM's.
+    (void)readRevision (c, b) ;
+
+  if (b->boardRev == 1)	// A, B, Rev 1, 1.1
+  {
+    b->pinToGpio  =  pinToGpioR1 ;
+    b->physToGpio = physToGpioR1 ;
+  }
+  else 			// A, B, Rev 2, B+, CM, Pi2
+  {
+    b->pinToGpio  =  pinToGpioR2 ;
+    b->physToGpio = physToGpioR2 ;
+  }
+
+// Newer boards have their peripherals elsewhere - we've got to get it
+//	from the device tree rather than guess and poke the wrong memory.
+
+  if ((b->periBase = readDtPeriBase ()) == 0)
+  {
+    if (!known)
+    {
+      b->why = "Unable to find the peripheral base address in the device tree" ;
+      return -1 ;
+    }
+    b->periBase = piModel2 ? 0x3F000000 : 0x20000000 ;
+  }
 
   if (wiringPiDebug)
-    printf ("piBoardRev: Returning revision: %d\n", boardRev) ;
+    printf ("piBoardRev: Returning revision: %d, peripherals at 0x%08X\n", b->boardRev, b->periBase) ;
+
+  b->state = 1 ;
 
-  return boardRev ;
+  return 0 ;
+}
+
+
+/*
+ * piBoardRevOops:
+ *	Tell them why we couldn't work out the board - the once.
+ *********************************************************************************
+ */
+
+static void piBoardRevOops (void)
+{
+  static int told = FALSE ;
+
+  if (told)
+    return ;
+  told = TRUE ;
+
+  fprintf (stderr, "piBoardRev: Unable to determine board revision from /proc/cpuinfo\n") ;
+  fprintf (stderr, " -> %s\n", piBoard.why) ;
+  fprintf (stderr, " ->  You may want to check:\n") ;
+  fprintf (stderr, " ->  http://www.raspberrypi.org/phpBB3/viewtopic.php?p=184410#p184410\n") ;
+}
+
+int piBoardRev (void)
+{
+  if (readBoard () < 0)
+  {
+    piBoardRevOops () ;
+    return -1 ;
+  }
+
+  return piBoard.boardRev ;
 }
 
 
@@ -758,6 +1050,7 @@ int piBoardRev (void)
  *	as much details as we can.
  *	This is undocumented and really only intended for the GPIO command.
  *	Use at your own risk!
+ *	If we can't tell what it is, it's all zeros.
  *
  * for Pi v2:
  *   [USER:8] [NEW:1] [MEMSIZE:3] [MANUFACTURER:4] [PROCESSOR:4] [TYPE:8] [REV:4]
@@ -772,96 +1065,17 @@ int piBoardRev (void)
 
 void piBoardId (int *model, int *rev, int *mem, int *maker, int *overVolted)
 {
-  FILE *cpuFd ;
-  char line [120] ;
-  char *c ;
-
-//	Will deal with the properly later on - for now, lets just get it going...
-//  unsigned int modelNum ;
-
-  (void)piBoardRev () ;	// Call this first to make sure all's OK. Don't care about the result.
-
-  if ((cpuFd = fopen ("/proc/cpuinfo", "r")) == NULL)
-    piBoardRevOops ("Unable to open /proc/cpuinfo") ;
-
-  while (fgets (line, 120, cpuFd) != NULL)
-    if (strncmp (line, "Revision", 8) == 0)
-      break ;
-
-  fclose (cpuFd) ;
-
-  if (strncmp (line, "Revision", 8) != 0)
-    piBoardRevOops ("No \"Revision\" line") ;
-
-// Chomp trailing CR/NL
-
-  for (c = &line [strlen (line) - 1] ; (*c == '\n') || (*c == '\r') ; --c)
-    *c = 0 ;
-  
-  if (wiringPiDebug)
-    printf ("piboardId: Revision string: %s\n", line) ;
-
-  if (piModel2)
+  if (piBoardRev () < 0)
   {
-
-// Scan to the colon
-
-    for (c = line ; *c ; ++c)
-      if (*c == ':')
-	break ;
-
-    if (*c != ':')
-      piBoardRevOops ("Bogus \"Revision\" line (no colon)") ;
-
-//    modelNum = (unsigned int)strtol (++c, NULL, 16) ; // Hex number with no leading 0x
-    
-    *model = PI_MODEL_2  ;
-    *rev   = PI_VERSION_1_1 ;
-    *mem   = 1024 ;
-    *maker = PI_MAKER_SONY   ;
+    *model = *rev = *mem = *maker = *overVolted = 0 ;
+    return ;
   }
-  else
-  {
-
-// Scan to first digit
-
-    for (c = line ; *c ; ++c)
-      if (isdigit (*c))
-	break ;
 
-// Make sure its long enough
-
-    if (strlen (c) < 4)
-      piBoardRevOops ("Bogus \"Revision\" line (not long enough)") ;
-
-// If longer than 4, we'll assume it's been overvolted
-
-    *overVolted = strlen (c) > 4 ;
-  
-// Extract last 4 characters:
-
-    c = c + strlen (c) - 4 ;
-
-// Fill out the replys as appropriate
-
-    /**/ if (strcmp (c, "0002") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_1   ; *mem = 256 ; *maker = PI_MAKER_EGOMAN ; }
-    else if (strcmp (c, "0003") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_1_1 ; *mem = 256 ; *maker = PI_MAKER_EGOMAN ; }
-    else if (strcmp (c, "0004") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 256 ; *maker = PI_MAKER_SONY   ; }
-    else if (strcmp (c, "0005") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 256 ; *maker = PI_MAKER_QISDA  ; }
-    else if (strcmp (c, "0006") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 256 ; *maker = PI_MAKER_EGOMAN ; }
-    else if (strcmp (c, "0007") == 0) { *model = PI_MODEL_A  ; *rev = PI_VERSION_2   ; *mem = 256 ; *maker = PI_MAKER_EGOMAN ; }
-    else if (strcmp (c, "0008") == 0) { *model = PI_MODEL_A  ; *rev = PI_VERSION_2   ; *mem = 256 ; *maker = PI_MAKER_SONY ; ; }
-    else if (strcmp (c, "0009") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 256 ; *maker = PI_MAKER_QISDA  ; }
-    else if (strcmp (c, "000d") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 512 ; *maker = PI_MAKER_EGOMAN ; }
-    else if (strcmp (c, "000e") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 512 ; *maker = PI_MAKER_SONY   ; }
-    else if (strcmp (c, "000f") == 0) { *model = PI_MODEL_B  ; *rev = PI_VERSION_2   ; *mem = 512 ; *maker = PI_MAKER_EGOMAN ; }
-    else if (strcmp (c, "0010") == 0) { *model = PI_MODEL_BP ; *rev = PI_VERSION_1_2 ; *mem = 512 ; *maker = PI_MAKER_SONY   ; }
-    else if (strcmp (c, "0011") == 0) { *model = PI_MODEL_CM ; *rev = PI_VERSION_1_2 ; *mem = 512 ; *maker = PI_MAKER_SONY   ; }
-    else if (strcmp (c, "0012") == 0) { *model = PI_MODEL_AP ; *rev = PI_VERSION_1_2 ; *mem = 256 ; *maker = PI_MAKER_SONY   ; }
-    else if (strcmp (c, "0013") == 0) { *model = PI_MODEL_BP ; *rev = PI_VERSION_1_2 ; *mem = 512 ; *maker = PI_MAKER_MBEST  ; }
-    else if (strcmp (c, "0014") == 0) { *model = PI_MODEL_CM ; *rev = PI_VERSION_1_2 ; *mem = 512 ; *maker = PI_MAKER_SONY   ; }
-    else                              { *model = 0           ; *rev = 0              ; *mem =   0 ; *maker = 0 ;               }
-  }
+  *model      = piBoard.model ;
+  *rev        = piBoard.rev ;
+  *mem        = piBoard.mem ;
+  *maker      = piBoard.maker ;
+  *overVolted = piBoard.overVolted ;
 }
  
 
@@ -907,6 +1121,9 @@ void setPadDrive (int group, int value)
     if ((group < 0) || (group > 2))
       return ;
 
+    if (!mapBlock (&pads, GPIO_PADS, "PADS"))
+      return ;
+
     wrVal = BCM_PASSWORD | 0x18 | (value & 7) ;
     *(pads + group + 11) = wrVal ;
 
@@ -958,6 +1175,9 @@ void pwmSetMode (int mode)
 {
   if ((wiringPiMode == WPI_MODE_PINS) || (wiringPiMode == WPI_MODE_PHYS) || (wiringPiMode == WPI_MODE_GPIO))
   {
+    if (!mapBlock (&pwm, GPIO_PWM, "PWM"))
+      return ;
+
     if (mode == PWM_MODE_MS)
       *(pwm + PWM_CONTROL) = PWM0_ENABLE | PWM1_ENABLE | PWM0_MS_MODE | PWM1_MS_MODE ;
     else
@@ -977,6 +1197,9 @@ void pwmSetRange (unsigned int range)
 {
   if ((wiringPiMode == WPI_MODE_PINS) || (wiringPiMode == WPI_MODE_PHYS) || (wiringPiMode == WPI_MODE_GPIO))
   {
+    if (!mapBlock (&pwm, GPIO_PWM, "PWM"))
+      return ;
+
     *(pwm + PWM0_RANGE) = range ; delayMicroseconds (10) ;
     *(pwm + PWM1_RANGE) = range ; delayMicroseconds (10) ;
   }
@@ -998,6 +1221,9 @@ void pwmSetClock (int divisor)
 
   if ((wiringPiMode == WPI_MODE_PINS) || (wiringPiMode == WPI_MODE_PHYS) || (wiringPiMode == WPI_MODE_GPIO))
   {
+    if (!mapBlock (&pwm, GPIO_PWM, "PWM") || !mapBlock (&clk, CLOCK_BASE, "CLOCK"))
+      return ;
+
     if (wiringPiDebug)
       printf ("Setting to: %d. Current: 0x%08X\n", divisor, *(clk + PWMCLK_DIV)) ;
 
@@ -1057,6 +1283,9 @@ void gpioClockSet (int pin, int freq)
   if (divi > 4095)
     divi = 4095 ;
 
+  if (!mapBlock (&clk, CLOCK_BASE, "CLOCK"))
+    return ;
+
   *(clk + gpioToClkCon [pin]) = BCM_PASSWORD | GPIO_CLOCK_SOURCE ;		// Stop GPIO Clock
   while ((*(clk + gpioToClkCon [pin]) & 0x80) != 0)				// ... and wait
     ;
@@ -1099,6 +1328,49 @@ static void digitalWriteDummy        (struct wiringPiNodeStruct *node, int pin,
 static void pwmWriteDummy            (struct wiringPiNodeStruct *node, int pin, int value) { return ; }
 static int  analogReadDummy          (struct wiringPiNodeStruct *node, int pin)            { return 0 ; }
 static void analogWriteDummy         (struct wiringPiNodeStruct *node, int pin, int value) { return ; }
+static void flushDummy               (struct wiringPiNodeStruct *node)                     { node->dirty = 0 ; }
+
+// Typed analog reads for nodes that only know analogRead: just the raw value
+
+static int analogReadExByRead (struct wiringPiNodeStruct *node, int pin, struct wpiSample *sample)
+{
+  wiringPiSampleSet (sample, node->analogRead (node, pin), 0, 1.0, 0.0, "") ;
+  return 0 ;
+}
+
+static int analogReadManyByPin (struct wiringPiNodeStruct *node, const int *chans, struct wpiSample *out, int n)
+{
+  int i ;
+
+  for (i = 0 ; i < n ; ++i)
+    if (node->analogReadEx (node, node->pinBase + chans [i], &out [i]) < 0)
+      break ;
+
+  return i ;
+}
+
+// Port-wide access for nodes that don't have anything better: go pin by pin
+
+static unsigned int digitalReadPortByPin (struct wiringPiNodeStruct *node)
+{
+  unsigned int value = 0 ;
+  int pin ;
+
+  for (pin = 0 ; (pin <= node->pinMax - node->pinBase) && (pin < 32) ; ++pin)
+    if (node->digitalRead (node, node->pinBase + pin) != LOW)
+      value |= 1U << pin ;
+
+  return value ;
+}
+
+static void digitalWritePortByPin (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value)
+{
+  int pin ;
+
+  for (pin = 0 ; (pin <= node->pinMax - node->pinBase) && (pin < 32) ; ++pin)
+    if ((mask & (1U << pin)) != 0)
+      node->digitalWrite (node, node->pinBase + pin, (value >> pin) & 1) ;
+}
 
 struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
 {
@@ -1129,6 +1401,11 @@ struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
   node->pwmWrite        = pwmWriteDummy ;
   node->analogRead      = analogReadDummy ;
   node->analogWrite     = analogWriteDummy ;
+  node->flush           = flushDummy ;
+  node->analogReadEx    = analogReadExByRead ;
+  node->analogReadMany  = analogReadManyByPin ;
+  node->digitalReadPort  = digitalReadPortByPin ;
+  node->digitalWritePort = digitalWritePortByPin ;
   node->next            = wiringPiNodes ;
   wiringPiNodes         = node ;
 
@@ -1136,6 +1413,50 @@ struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
 }
 
 
+/*
+ * wiringPiNodeDefer:
+ *	Turn write coalescing on or off for the device node at pinBase.
+ *	While deferred, digitalWrite on a supporting node (mcp23017,
+ *	mcp23s17, pcf8574) only updates the output shadow and marks the
+ *	port dirty - nothing goes out on the bus until the node is flushed.
+ *	Turning it off flushes anything still pending.
+ *********************************************************************************
+ */
+
+void wiringPiNodeDefer (int pinBase, int defer)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return ;
+
+  node->deferred = defer ;
+
+  if (!defer)
+    wiringPiNodeFlush (pinBase) ;
+}
+
+
+/*
+ * wiringPiNodeFlush:
+ *	Push any pending (deferred) writes out to the device - one bus
+ *	transaction per dirty port. The node's flush clears dirty itself,
+ *	under its bus lock.
+ *********************************************************************************
+ */
+
+void wiringPiNodeFlush (int pinBase)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return ;
+
+  if (node->dirty != 0)
+    node->flush (node) ;
+}
+
+
 #ifdef notYetReady
 /*
  * pinED01:
@@ -1154,23 +1475,719 @@ void pinEnableED01Pi (int pin)
 
 /*
  *********************************************************************************
- * Core Functions
+ * GPIO character device
+ *	The on-board pins are lines on /dev/gpiochipN and we talk to them
+ *	via the line handle ioctls. No root or /sys/class/gpio needed.
  *********************************************************************************
  */
 
 /*
- * pinModeAlt:
- *	This is an un-documented special to let you set any pin to any mode
+ * chipReleaseHandle: chipRelease:
+ *	Give up the plain line handle we have on a line, or everything -
+ *	the event handle too. Only wiringPiTeardown does the latter; a
+ *	pin being watched for edges otherwise keeps its event handle.
+ *	Anyone in waitForEdge on it is woken up and gets -2.
  *********************************************************************************
  */
 
-void pinModeAlt (int pin, int mode)
+static void chipReleaseHandle (int pin)
 {
-  int fSel, shift ;
-
-  if ((pin & PI_GPIO_MASK) == 0)		// On-board pin
+  if (chipHandles [pin] != -1)
   {
-    /**/ if (wiringPiMode == WPI_MODE_PINS)
+    close (chipHandles [pin]) ;
+    chipHandles [pin] = -1 ;
+  }
+}
+
+static void chipRelease (int pin)
+{
+  uint64_t kick = 1 ;
+
+  chipReleaseHandle (pin) ;
+
+  if (chipEvents [pin] != -1)
+  {
+    pthread_mutex_lock (&chipMutex) ;
+
+    if (chipWaiters [pin] > 0)
+      (void)write (chipWake [pin], &kick, sizeof (kick)) ;
+
+    while (chipWaiters [pin] > 0)
+      pthread_cond_wait (&chipCond, &chipMutex) ;
+
+    close (chipEvents [pin]) ;
+    chipEvents [pin] = -1 ;
+
+    pthread_mutex_unlock (&chipMutex) ;
+  }
+
+  if (chipWake [pin] != -1)
+  {
+    close (chipWake [pin]) ;
+    chipWake [pin] = -1 ;
+  }
+}
+
+
+/*
+ * chipRequest:
+ *	Get a handle on a single line with the given flags, giving up any
+ *	we already had. A pin being watched for edges is left alone.
+ *	Returns the handle or -1.
+ *********************************************************************************
+ */
+
+static void chipGroupDrop (int pin) ;
+
+static int chipRequest (int pin, int flags, int value)
+{
+  struct gpiohandle_request req ;
+
+  if ((pin < 0) || (pin >= chipLines) || (chipEvents [pin] != -1))
+    return -1 ;
+
+  chipGroupDrop     (pin) ;
+  chipReleaseHandle (pin) ;
+
+  memset (&req, 0, sizeof (req)) ;
+  req.lineoffsets    [0] = pin ;
+  req.lines              = 1 ;
+  req.flags              = flags ;
+  req.default_values [0] = (value == LOW) ? 0 : 1 ;
+  strcpy (req.consumer_label, "wiringPi") ;
+
+  if (ioctl (chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+    return -1 ;
+
+  chipOutput [pin] = (flags & GPIOHANDLE_REQUEST_OUTPUT) != 0 ;
+  chipValue  [pin] = (value == LOW) ? LOW : HIGH ;
+
+  return chipHandles [pin] = req.fd ;
+}
+
+
+/*
+ * chipGroup:
+ *	digitalReadMany and digitalWriteMany use one multi-line handle for
+ *	their on-board pins, so it's one ioctl for the lot. We keep the last
+ *	one, as they tend to be called over and over with the same pins.
+ *	It's only a cache: a pin in it that's wanted for anything else gets
+ *	the group broken back up into single-line handles as they were.
+ *********************************************************************************
+ */
+
+static int chipGroupIndex (int pin)
+{
+  int i ;
+
+  if (chipGroup.fd != -1)
+    for (i = 0 ; i < chipGroup.count ; ++i)
+      if (chipGroup.pins [i] == pin)
+	return i ;
+
+  return -1 ;
+}
+
+static void chipGroupRelease (void)
+{
+  int i, pin ;
+
+  if (chipGroup.fd == -1)
+    return ;
+
+  close (chipGroup.fd) ;
+  chipGroup.fd = -1 ;
+
+  for (i = 0 ; i < chipGroup.count ; ++i)
+  {
+    pin = chipGroup.pins [i] ;
+    if (chipGroup.output)
+      (void)chipRequest (pin, GPIOHANDLE_REQUEST_OUTPUT, chipValue [pin]) ;
+    else
+      (void)chipRequest (pin, GPIOHANDLE_REQUEST_INPUT | chipBias [pin], LOW) ;
+  }
+}
+
+static void chipGroupDrop (int pin)
+{
+  if (chipGroupIndex (pin) != -1)
+    chipGroupRelease () ;
+}
+
+
+/*
+ * chipGroupGet:
+ *	Return a multi-line handle for the pins, all outputs (starting with
+ *	values) or all inputs. Returns -1 if they can't share one: a pin
+ *	being watched for edges, a repeated pin, one we already have going
+ *	the other way or inputs with different pulls - the caller goes pin
+ *	by pin then.
+ *********************************************************************************
+ */
+
+static int chipGroupGet (const int *pins, const unsigned char *values, int count, int output)
+{
+  struct gpiohandle_request req ;
+  int had [32] ;
+  int i, j, pin, held ;
+
+  if ((count < 1) || (count > 32))
+    return -1 ;
+
+  if ((chipGroup.fd != -1) && (chipGroup.output == output) && (chipGroup.count == count) &&
+	(memcmp (chipGroup.pins, pins, count * sizeof (int)) == 0))
+    return chipGroup.fd ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    pin = pins [i] ;
+
+    if ((pin < 0) || (pin >= chipLines) || (chipEvents [pin] != -1))
+      return -1 ;
+
+    held = (chipHandles [pin] != -1) || (chipGroupIndex (pin) != -1) ;
+
+    if (held && (chipOutput [pin] != output))
+      return -1 ;
+
+    if (!output && (chipBias [pin] != chipBias [pins [0]]))
+      return -1 ;
+
+    for (j = 0 ; j < i ; ++j)
+      if (pins [j] == pin)
+	return -1 ;
+  }
+
+  chipGroupRelease () ;
+
+  memset (&req, 0, sizeof (req)) ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    pin     = pins [i] ;
+    had [i] = (chipHandles [pin] != -1) ;
+    chipReleaseHandle (pin) ;
+
+    req.lineoffsets [i] = pin ;
+    if (output)
+      req.default_values [i] = values [i] ;
+  }
+
+  req.lines = count ;
+  req.flags = output ? GPIOHANDLE_REQUEST_OUTPUT : (GPIOHANDLE_REQUEST_INPUT | chipBias [pins [0]]) ;
+  strcpy (req.consumer_label, "wiringPi") ;
+
+  if (ioctl (chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)	// Put back what they had
+  {
+    for (i = 0 ; i < count ; ++i)
+      if (had [i])
+      {
+	pin = pins [i] ;
+	if (chipOutput [pin])
+	  (void)chipRequest (pin, GPIOHANDLE_REQUEST_OUTPUT, chipValue [pin]) ;
+	else
+	  (void)chipRequest (pin, GPIOHANDLE_REQUEST_INPUT | chipBias [pin], LOW) ;
+      }
+    return -1 ;
+  }
+
+  chipGroup.fd     = req.fd ;
+  chipGroup.output = output ;
+  chipGroup.count  = count ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    pin                = pins [i] ;
+    chipGroup.pins [i] = pin ;
+    chipOutput [pin]   = output ;
+    if (output)
+      chipValue [pin] = values [i] ;
+  }
+
+  return req.fd ;
+}
+
+
+/*
+ * chipReadMany: chipWriteMany:
+ *	The on-board end of digitalReadMany/WriteMany - a single ioctl
+ *	through the group handle if we can, else one per pin.
+ *********************************************************************************
+ */
+
+static int chipRead  (int pin) ;
+static void chipWrite (int pin, int value) ;
+
+static void chipReadMany (const int *pins, unsigned char *values, int count)
+{
+  struct gpiohandle_data data ;
+  int fd, i ;
+
+  if (((fd = chipGroupGet (pins, NULL, count, FALSE)) != -1) && (ioctl (fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) == 0))
+  {
+    for (i = 0 ; i < count ; ++i)
+      values [i] = data.values [i] ;
+    return ;
+  }
+
+  for (i = 0 ; i < count ; ++i)
+    values [i] = chipRead (pins [i]) ;
+}
+
+static void chipWriteMany (const int *pins, const unsigned char *values, int count)
+{
+  struct gpiohandle_data data ;
+  int fd, i ;
+
+  if ((fd = chipGroupGet (pins, values, count, TRUE)) != -1)
+  {
+    for (i = 0 ; i < count ; ++i)		// A new handle starts with them
+      if (chipValue [pins [i]] != values [i])
+	break ;
+
+    if (i == count)
+      return ;
+
+    memset (&data, 0, sizeof (data)) ;
+    for (i = 0 ; i < count ; ++i)
+      data.values [i] = values [i] ;
+
+    if (ioctl (fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) == 0)
+    {
+      for (i = 0 ; i < count ; ++i)
+	chipValue [pins [i]] = values [i] ;
+      return ;
+    }
+  }
+
+  for (i = 0 ; i < count ; ++i)
+    chipWrite (pins [i], values [i]) ;
+}
+
+
+/*
+ * chipEventRequest:
+ *	Ask for edge events on a line, with its pull-up/down. Returns the
+ *	event handle or -1.
+ *********************************************************************************
+ */
+
+static int chipEventRequest (int pin, int edgeType, int bias)
+{
+  struct gpioevent_request req ;
+
+  memset (&req, 0, sizeof (req)) ;
+  req.lineoffset  = pin ;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT | bias ;
+
+  /**/ if (edgeType == INT_EDGE_FALLING)
+    req.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE ;
+  else if (edgeType == INT_EDGE_RISING)
+    req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE ;
+  else
+    req.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES ;
+
+  strcpy (req.consumer_label, "wiringPi") ;
+
+  if (ioctl (chipFd, GPIO_GET_LINEEVENT_IOCTL, &req) < 0)
+    return -1 ;
+
+  return req.fd ;
+}
+
+
+/*
+ * chipRewatch:
+ *	Change the edge or pull-up/down on a pin being watched. The event
+ *	handle has to be re-requested for that, and the kernel won't give
+ *	us the line again while anyone's still polling the old one - so
+ *	we kick any waitForEdge callers (e.g. the wiringPiISR thread) out
+ *	of their poll, hold them off while we swap it, then let them go
+ *	again. If the new request fails we go back to the old settings.
+ *	Returns 0 or -1.
+ *********************************************************************************
+ */
+
+static int chipRewatch (int pin, int edgeType, int bias)
+{
+  uint64_t kick = 1 ;
+  int result = 0 ;
+
+  pthread_mutex_lock (&chipMutex) ;
+
+  chipBusy [pin] = TRUE ;
+
+  if (chipWaiters [pin] > 0)
+    (void)write (chipWake [pin], &kick, sizeof (kick)) ;
+
+  while (chipWaiters [pin] > 0)
+    pthread_cond_wait (&chipCond, &chipMutex) ;
+
+  (void)read (chipWake [pin], &kick, sizeof (kick)) ;	// Non-blocking - just clear it
+
+  close (chipEvents [pin]) ;
+
+  if ((chipEvents [pin] = chipEventRequest (pin, edgeType, bias)) != -1)
+  {
+    chipEdges [pin] = edgeType ;
+    chipBias  [pin] = bias ;
+  }
+  else
+  {
+    chipEvents [pin] = chipEventRequest (pin, chipEdges [pin], chipBias [pin]) ;
+    result = -1 ;
+  }
+
+  chipBusy [pin] = FALSE ;
+  pthread_cond_broadcast (&chipCond) ;
+
+  pthread_mutex_unlock (&chipMutex) ;
+
+  return result ;
+}
+
+
+/*
+ * chipPinMode: chipPullUpDnControl:
+ *	Only input and output make sense here. The pull-up/down is a
+ *	property of the request, so remember it and re-request the line.
+ *	A pin being watched for edges stays an input, but does take a new
+ *	pull-up/down - the event handle is re-requested with it.
+ *********************************************************************************
+ */
+
+static void chipPinMode (int pin, int mode)
+{
+  if ((pin < 0) || (pin >= chipLines) || (chipEvents [pin] != -1))
+    return ;
+
+  /**/ if (mode == INPUT)
+    (void)chipRequest (pin, GPIOHANDLE_REQUEST_INPUT | chipBias [pin], LOW) ;
+  else if (mode == OUTPUT)
+    (void)chipRequest (pin, GPIOHANDLE_REQUEST_OUTPUT, LOW) ;
+}
+
+static void chipPullUpDnControl (int pin, int pud)
+{
+#ifdef	GPIOHANDLE_REQUEST_BIAS_PULL_UP
+  int bias ;
+
+  if ((pin < 0) || (pin >= chipLines))
+    return ;
+
+  /**/ if (pud == PUD_UP)
+    bias = GPIOHANDLE_REQUEST_BIAS_PULL_UP ;
+  else if (pud == PUD_DOWN)
+    bias = GPIOHANDLE_REQUEST_BIAS_PULL_DOWN ;
+  else
+    bias = GPIOHANDLE_REQUEST_BIAS_DISABLE ;
+
+  if (chipEvents [pin] != -1)
+  {
+    (void)chipRewatch (pin, chipEdges [pin], bias) ;
+    return ;
+  }
+
+  chipBias [pin] = bias ;
+  (void)chipRequest (pin, GPIOHANDLE_REQUEST_INPUT | bias, LOW) ;
+#endif
+}
+
+
+/*
+ * chipRead: chipWrite:
+ *	One ioctl each. A pin we've not seen before is made an input for
+ *	a read or an output for a write. Writes to a pin being watched for
+ *	edges are ignored.
+ *********************************************************************************
+ */
+
+static int chipRead (int pin)
+{
+  struct gpiohandle_data data ;
+  int fd, i ;
+
+  if ((pin < 0) || (pin >= chipLines))
+    return LOW ;
+
+  /**/ if ((i = chipGroupIndex (pin)) != -1)
+    fd = chipGroup.fd ;
+  else if (chipHandles [pin] != -1)
+    fd = chipHandles [pin] ;
+  else if (chipEvents [pin] != -1)
+    fd = chipEvents [pin] ;
+  else if ((fd = chipRequest (pin, GPIOHANDLE_REQUEST_INPUT | chipBias [pin], LOW)) == -1)
+    return LOW ;
+
+  if (ioctl (fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+    return LOW ;
+
+  return (data.values [(i == -1) ? 0 : i] == 0) ? LOW : HIGH ;
+}
+
+static void chipWrite (int pin, int value)
+{
+  struct gpiohandle_data data ;
+  int i ;
+
+  if ((pin < 0) || (pin >= chipLines) || (chipEvents [pin] != -1))
+    return ;
+
+  value = (value == LOW) ? LOW : HIGH ;
+
+// Part of an output group: the others keep their values
+
+  if ((i = chipGroupIndex (pin)) != -1)
+  {
+    if (chipGroup.output)
+    {
+      chipValue [pin] = value ;
+
+      memset (&data, 0, sizeof (data)) ;
+      for (i = 0 ; i < chipGroup.count ; ++i)
+	data.values [i] = chipValue [chipGroup.pins [i]] ;
+
+      (void)ioctl (chipGroup.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) ;
+      return ;
+    }
+    chipGroupRelease () ;
+  }
+
+  if (chipHandles [pin] == -1)
+  {
+    (void)chipRequest (pin, GPIOHANDLE_REQUEST_OUTPUT, value) ;	// Sets it too
+    return ;
+  }
+
+  memset (&data, 0, sizeof (data)) ;
+  data.values [0] = value ;
+
+  if (ioctl (chipHandles [pin], GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) == 0)
+    chipValue [pin] = value ;
+}
+
+
+/*
+ * wiringPiGpioChipLines:
+ *	Request up to 64 lines as a group, all inputs or all outputs, so
+ *	they can be read or written together with a single ioctl by
+ *	wiringPiGpioChipRead/Write. Any handles the pins had already are
+ *	given up; close () the one returned when you're done with it.
+ *	Pins being watched for edges can't be included.
+ *	Returns the handle or -1.
+ *********************************************************************************
+ */
+
+int wiringPiGpioChipLines (const int *pins, int count, int mode)
+{
+  struct gpiohandle_request req ;
+  int i ;
+
+  if ((chipFd == -1) || (count < 1) || (count > GPIOHANDLES_MAX))
+    return -1 ;
+
+  for (i = 0 ; i < count ; ++i)
+    if ((pins [i] < 0) || (pins [i] >= chipLines) || (chipEvents [pins [i]] != -1))
+      return -1 ;
+
+  memset (&req, 0, sizeof (req)) ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    chipGroupDrop     (pins [i]) ;
+    chipReleaseHandle (pins [i]) ;
+    req.lineoffsets [i] = pins [i] ;
+  }
+
+  req.lines = count ;
+  req.flags = (mode == OUTPUT) ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT ;
+  strcpy (req.consumer_label, "wiringPi") ;
+
+  if (ioctl (chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+    return -1 ;
+
+  return req.fd ;
+}
+
+
+/*
+ * wiringPiGpioChipRead: wiringPiGpioChipWrite:
+ *	Read or write all the lines of a group in one go. values [i] is
+ *	for the i'th pin the group was requested with.
+ *********************************************************************************
+ */
+
+int wiringPiGpioChipRead (int handle, unsigned char *values, int count)
+{
+  struct gpiohandle_data data ;
+  int i ;
+
+  if ((count < 1) || (count > GPIOHANDLES_MAX))
+    return -1 ;
+
+  if (ioctl (handle, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+    return -1 ;
+
+  for (i = 0 ; i < count ; ++i)
+    values [i] = data.values [i] ;
+
+  return 0 ;
+}
+
+int wiringPiGpioChipWrite (int handle, const unsigned char *values, int count)
+{
+  struct gpiohandle_data data ;
+  int i ;
+
+  if ((count < 1) || (count > GPIOHANDLES_MAX))
+    return -1 ;
+
+  memset (&data, 0, sizeof (data)) ;
+  for (i = 0 ; i < count ; ++i)
+    data.values [i] = (values [i] != 0) ;
+
+  return ioctl (handle, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) ;
+}
+
+
+/*
+ * wiringPiGpioChipEdge:
+ *	Ask the kernel to watch a pin for edges - INT_EDGE_FALLING,
+ *	INT_EDGE_RISING or INT_EDGE_BOTH. Collect them with waitForEdge,
+ *	waitForInterrupt or via wiringPiISR. The pin's still readable, and
+ *	calling this again just changes the edge. It stays watched (and an
+ *	input) until wiringPiTeardown.
+ *********************************************************************************
+ */
+
+int wiringPiGpioChipEdge (int pin, int edgeType)
+{
+  if ((chipFd == -1) || (pin < 0) || (pin >= chipLines))
+    return -1 ;
+
+  if (chipEvents [pin] != -1)
+    return chipRewatch (pin, edgeType, chipBias [pin]) ;
+
+  if ((chipWake [pin] == -1) && ((chipWake [pin] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1))
+    return -1 ;
+
+  chipGroupDrop     (pin) ;
+  chipReleaseHandle (pin) ;
+
+  pthread_mutex_lock (&chipMutex) ;
+    chipEvents [pin] = chipEventRequest (pin, edgeType, chipBias [pin]) ;
+    chipEdges  [pin] = edgeType ;
+  pthread_mutex_unlock (&chipMutex) ;
+
+  return (chipEvents [pin] == -1) ? -1 : 0 ;
+}
+
+
+/*
+ * waitForEdge:
+ *	Wait up to mS (-1 for ever) for an edge on a pin set up with
+ *	wiringPiGpioChipEdge. The kernel timestamps each one when it
+ *	happens, so the time is good even if we were slow to get here.
+ *	If the pin's edge or pull-up/down is changed while we wait, we
+ *	carry on waiting on the new event handle (and the timeout starts
+ *	again).
+ *	Returns 1 with the edge filled in (if not NULL), 0 on timeout,
+ *	-1 on error or -2 if the pin's not being watched.
+ *********************************************************************************
+ */
+
+static void chipWaitDone (void *arg)
+{
+  int pin = *(int *)arg ;
+
+  pthread_mutex_lock (&chipMutex) ;
+    if (--chipWaiters [pin] == 0)
+      pthread_cond_broadcast (&chipCond) ;
+  pthread_mutex_unlock (&chipMutex) ;
+}
+
+int waitForEdge (int pin, int mS, struct wpiEdge *edge)
+{
+  struct gpioevent_data event ;
+  struct pollfd polls [2] ;
+  int x, cancelState ;
+
+  if ((wiringPiMode != WPI_MODE_GPIO_CHIP) || (pin < 0) || (pin > 63))
+    return -2 ;
+
+// Only let the thread be cancelled in the poll, not holding the lock
+
+  pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &cancelState) ;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&chipMutex) ;
+
+    while (chipBusy [pin])
+      pthread_cond_wait (&chipCond, &chipMutex) ;
+
+    if (chipEvents [pin] == -1)
+    {
+      pthread_mutex_unlock (&chipMutex) ;
+      x = -2 ;
+      break ;
+    }
+
+    ++chipWaiters [pin] ;
+
+    polls [0].fd     = chipEvents [pin] ;
+    polls [0].events = POLLIN ;
+    polls [1].fd     = chipWake [pin] ;
+    polls [1].events = POLLIN ;
+
+    pthread_mutex_unlock (&chipMutex) ;
+
+    pthread_cleanup_push (chipWaitDone, &pin) ;
+      pthread_setcancelstate (cancelState, NULL) ;
+      x = poll (polls, 2, mS) ;
+      pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, NULL) ;
+
+      if ((x > 0) && ((polls [0].revents & POLLIN) != 0))
+	x = (read (polls [0].fd, &event, sizeof (event)) == sizeof (event)) ? 1 : -1 ;
+      else if (x > 0)		// Kicked by chipRewatch
+	x = -3 ;
+    pthread_cleanup_pop (1) ;
+
+    if (x != -3)
+      break ;
+  }
+
+  pthread_setcancelstate (cancelState, NULL) ;
+
+  if ((x == 1) && (edge != NULL))
+  {
+    edge->timestamp = event.timestamp ;
+    edge->rising    = (event.id == GPIOEVENT_EVENT_RISING_EDGE) ;
+  }
+
+  return x ;
+}
+
+
+/*
+ *********************************************************************************
+ * Core Functions
+ *********************************************************************************
+ */
+
+/*
+ * pinModeAlt:
+ *	This is an un-documented special to let you set any pin to any mode
+ *********************************************************************************
+ */
+
+void pinModeAlt (int pin, int mode)
+{
+  int fSel, shift ;
+
+  if ((pin & PI_GPIO_MASK) == 0)		// On-board pin
+  {
+    /**/ if (wiringPiMode == WPI_MODE_PINS)
       pin = pinToGpio [pin] ;
     else if (wiringPiMode == WPI_MODE_PHYS)
       pin = physToGpio [pin] ;
@@ -1203,6 +2220,11 @@ void pinMode (int pin, int mode)
       pin = pinToGpio [pin] ;
     else if (wiringPiMode == WPI_MODE_PHYS)
       pin = physToGpio [pin] ;
+    else if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+    {
+      chipPinMode (pin, mode) ;
+      return ;
+    }
     else if (wiringPiMode != WPI_MODE_GPIO)
       return ;
 
@@ -1279,6 +2301,11 @@ void pullUpDnControl (int pin, int pud)
       pin = pinToGpio [pin] ;
     else if (wiringPiMode == WPI_MODE_PHYS)
       pin = physToGpio [pin] ;
+    else if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+    {
+      chipPullUpDnControl (pin, pud) ;
+      return ;
+    }
     else if (wiringPiMode != WPI_MODE_GPIO)
       return ;
 
@@ -1297,6 +2324,30 @@ void pullUpDnControl (int pin, int pud)
 }
 
 
+/*
+ * sysFd:
+ *	Return the fd for a pin's /sys/class/gpio value file, opening it
+ *	the first time it's wanted. -1 if the pin's not exported - and we
+ *	remember that, so reading an unexported pin doesn't cost a failed
+ *	open () every time.
+ *********************************************************************************
+ */
+
+static int sysFd (int pin)
+{
+  char fName [128] ;
+
+  if (sysFds [pin] == -1)
+  {
+    sprintf (fName, "/sys/class/gpio/gpio%d/value", pin) ;
+    if ((sysFds [pin] = open (fName, O_RDWR | O_CLOEXEC)) < 0)
+      sysFds [pin] = SYS_FD_MISSING ;
+  }
+
+  return (sysFds [pin] < 0) ? -1 : sysFds [pin] ;
+}
+
+
 /*
  * digitalRead:
  *	Read the value of a given Pin, returning HIGH or LOW
@@ -1306,19 +2357,23 @@ void pullUpDnControl (int pin, int pud)
 int digitalRead (int pin)
 {
   char c ;
+  int  fd ;
   struct wiringPiNodeStruct *node = wiringPiNodes ;
 
   if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
   {
     /**/ if (wiringPiMode == WPI_MODE_GPIO_SYS)	// Sys mode
     {
-      if (sysFds [pin] == -1)
+      if ((fd = sysFd (pin)) == -1)
+	return LOW ;
+
+      if (pread (fd, &c, 1, 0) != 1)		// One syscall, no need to seek
 	return LOW ;
 
-      lseek  (sysFds [pin], 0L, SEEK_SET) ;
-      read   (sysFds [pin], &c, 1) ;
       return (c == '0') ? LOW : HIGH ;
     }
+    else if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+      return chipRead (pin) ;
     else if (wiringPiMode == WPI_MODE_PINS)
       pin = pinToGpio [pin] ;
     else if (wiringPiMode == WPI_MODE_PHYS)
@@ -1348,19 +2403,20 @@ int digitalRead (int pin)
 
 void digitalWrite (int pin, int value)
 {
+  int fd ;
   struct wiringPiNodeStruct *node = wiringPiNodes ;
 
   if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
   {
     /**/ if (wiringPiMode == WPI_MODE_GPIO_SYS)	// Sys mode
     {
-      if (sysFds [pin] != -1)
-      {
-	if (value == LOW)
-	  write (sysFds [pin], "0\n", 2) ;
-	else
-	  write (sysFds [pin], "1\n", 2) ;
-      }
+      if ((fd = sysFd (pin)) != -1)
+	write (fd, (value == LOW) ? "0" : "1", 1) ;
+      return ;
+    }
+    else if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+    {
+      chipWrite (pin, value) ;
       return ;
     }
     else if (wiringPiMode == WPI_MODE_PINS)
@@ -1402,6 +2458,9 @@ void pwmWrite (int pin, int value)
     else if (wiringPiMode != WPI_MODE_GPIO)
       return ;
 
+    if (!mapBlock (&pwm, GPIO_PWM, "PWM"))
+      return ;
+
     *(pwm + gpioToPwmPort [pin]) = value ;
   }
   else
@@ -1450,6 +2509,105 @@ void analogWrite (int pin, int value)
 }
 
 
+/*
+ * wiringPiSampleSet:
+ *	Fill in a sample for a node driver. The value and timestamp are
+ *	worked out here so every driver does it the same way.
+ *********************************************************************************
+ */
+
+void wiringPiSampleSet (struct wpiSample *sample, int raw, int bits, double scale, double offset, const char *units)
+{
+  sample->raw       = raw ;
+  sample->bits      = bits ;
+  sample->scale     = scale ;
+  sample->offset    = offset ;
+  sample->value     = (double)raw * scale + offset ;
+  sample->units     = units ;
+  sample->timestamp = micros () ;
+  sample->flags     = 0 ;
+}
+
+
+/*
+ * analogReadEx:
+ *	Read the analog value of a given pin along with its resolution,
+ *	scaling and units. Returns 0, or -1 with WPI_SAMPLE_ERROR set in
+ *	the sample's flags.
+ *********************************************************************************
+ */
+
+int analogReadEx (int pin, struct wpiSample *sample)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pin)) == NULL)
+  {
+    wiringPiSampleSet (sample, 0, 0, 1.0, 0.0, "") ;
+    sample->flags = WPI_SAMPLE_ERROR ;
+    return -1 ;
+  }
+
+  return node->analogReadEx (node, pin, sample) ;
+}
+
+
+/*
+ * analogReadMany:
+ *	Read a list of channels (0 being pinBase) from the one device node.
+ *	Multi-channel devices can scan them in a single operation.
+ *	Returns the number of samples read.
+ *********************************************************************************
+ */
+
+int analogReadMany (int pinBase, const int *chans, struct wpiSample *out, int n)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return -1 ;
+
+  return node->analogReadMany (node, chans, out, n) ;
+}
+
+
+/*
+ * digitalReadNode:
+ *	Read all the pins of a device node in one go - bit 0 of the result
+ *	is the node's pinBase. Nodes which support it do this with a single
+ *	bus transaction, others fall back to reading pin by pin.
+ *********************************************************************************
+ */
+
+unsigned int digitalReadNode (int pinBase)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return 0 ;
+
+  return node->digitalReadPort (node) ;
+}
+
+
+/*
+ * digitalWriteNode:
+ *	Write the bits set in mask to the pins of a device node. Bits
+ *	not in the mask keep their current output state.
+ *********************************************************************************
+ */
+
+void digitalWriteNode (int pinBase, unsigned int mask, unsigned int value)
+{
+  struct wiringPiNodeStruct *node ;
+
+  if ((node = wiringPiFindNode (pinBase)) == NULL)
+    return ;
+
+  node->digitalWritePort (node, mask, value) ;
+}
+
+
 /*
  * pwmToneWrite:
  *	Pi Specific.
@@ -1457,64 +2615,272 @@ void analogWrite (int pin, int value)
  *********************************************************************************
  */
 
-void pwmToneWrite (int pin, int freq)
-{
-  int range ;
+void pwmToneWrite (int pin, int freq)
+{
+  int range ;
+
+  if (freq == 0)
+    pwmWrite (pin, 0) ;             // Off
+  else
+  {
+    range = 600000 / freq ;
+    pwmSetRange (range) ;
+    pwmWrite    (pin, freq / 2) ;
+  }
+}
+
+
+
+/*
+ * digitalWriteByte:
+ *	Pi Specific
+ *	Write an 8-bit byte to the first 8 GPIO pins - try to do it as
+ *	fast as possible.
+ *	However it still needs 2 operations to set the bits, so any external
+ *	hardware must not rely on seeing a change as there will be a change 
+ *	to set the outputs bits to zero, then another change to set the 1's
+ *********************************************************************************
+ */
+
+void digitalWriteByte (int value)
+{
+  uint32_t pinSet = 0 ;
+  uint32_t pinClr = 0 ;
+  int mask = 1 ;
+  int pin ;
+
+  /**/ if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  {
+    for (pin = 0 ; pin < 8 ; ++pin)
+    {
+      digitalWrite (pin, value & mask) ;
+      mask <<= 1 ;
+    }
+    return ;
+  }
+  else
+  {
+    for (pin = 0 ; pin < 8 ; ++pin)
+    {
+      if ((value & mask) == 0)
+	pinClr |= (1 << pinToGpio [pin]) ;
+      else
+	pinSet |= (1 << pinToGpio [pin]) ;
+
+      mask <<= 1 ;
+    }
+
+    *(gpio + gpioToGPCLR [0]) = pinClr ;
+    *(gpio + gpioToGPSET [0]) = pinSet ;
+  }
+}
+
+
+/*
+ * digitalWriteMany:
+ *	Write bit n of value to pins [n], for up to 32 pins, as near to all
+ *	at once as we can: on-board pins with one clear and one set per
+ *	GPIO bank (or one ioctl for the lot with the GPIO character device),
+ *	and consecutive pins on the same device node with one port write.
+ *	Anything else goes through digitalWrite.
+ *********************************************************************************
+ */
+
+void digitalWriteMany (const int *pins, int count, unsigned int value)
+{
+  uint32_t pinSet [2] = { 0, 0 } ;
+  uint32_t pinClr [2] = { 0, 0 } ;
+  struct wiringPiNodeStruct *node, *group = NULL ;
+  unsigned int groupMask = 0, groupValue = 0 ;
+  int i, pin, bit, offset ;
+  int onBoard = FALSE ;
+  int chipPins [32], chipCount = 0 ;
+  unsigned char chipValues [32] ;
+
+  if (count > 32)
+    count = 32 ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    pin = pins  [i] ;
+    bit = (value >> i) & 1 ;
+
+    if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
+    {
+      /**/ if (wiringPiMode == WPI_MODE_PINS)
+	pin = pinToGpio [pin] ;
+      else if (wiringPiMode == WPI_MODE_PHYS)
+	pin = physToGpio [pin] ;
+      else if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+      {
+	chipPins   [chipCount]   = pin ;
+	chipValues [chipCount++] = bit ;
+	continue ;
+      }
+      else if (wiringPiMode != WPI_MODE_GPIO)
+      {
+	digitalWrite (pin, bit) ;
+	continue ;
+      }
+
+      if (bit == LOW)
+	pinClr [(pin >> 5) & 1] |= 1 << (pin & 31) ;
+      else
+	pinSet [(pin >> 5) & 1] |= 1 << (pin & 31) ;
+      onBoard = TRUE ;
+    }
+    else if ((node = wiringPiFindNode (pin)) != NULL)
+    {
+      if (node != group)
+      {
+	if (group != NULL)
+	  group->digitalWritePort (group, groupMask, groupValue) ;
+	group      = node ;
+	groupMask  = 0 ;
+	groupValue = 0 ;
+      }
+
+      if ((offset = pin - node->pinBase) < 32)
+      {
+	groupMask  |= 1   << offset ;
+	groupValue |= bit << offset ;
+      }
+      else
+	node->digitalWrite (node, pin, bit) ;
+    }
+  }
+
+  if (group != NULL)
+    group->digitalWritePort (group, groupMask, groupValue) ;
+
+  if (chipCount > 0)
+    chipWriteMany (chipPins, chipValues, chipCount) ;
+
+  if (onBoard)
+  {
+    if (pinClr [0] != 0) *(gpio + gpioToGPCLR [ 0]) = pinClr [0] ;
+    if (pinClr [1] != 0) *(gpio + gpioToGPCLR [32]) = pinClr [1] ;
+    if (pinSet [0] != 0) *(gpio + gpioToGPSET [ 0]) = pinSet [0] ;
+    if (pinSet [1] != 0) *(gpio + gpioToGPSET [32]) = pinSet [1] ;
+  }
+}
+
+
+/*
+ * digitalReadMany:
+ *	Read pins [n] into bit n of the result, for up to 32 pins. On-board
+ *	pins need one register read per GPIO bank (one ioctl for the lot with
+ *	the GPIO character device) and device nodes one port read each; in
+ *	sys mode it's a single pread per pin.
+ *********************************************************************************
+ */
+
+unsigned int digitalReadMany (const int *pins, int count)
+{
+  uint32_t level [2] = { 0, 0 } ;
+  int      levelRead [2] = { FALSE, FALSE } ;
+  struct wiringPiNodeStruct *node, *group = NULL ;
+  unsigned int groupValue = 0, value = 0 ;
+  int i, pin, bank, offset ;
+  int chipPins [32], chipBits [32], chipCount = 0 ;
+  unsigned char chipValues [32] ;
+
+  if (count > 32)
+    count = 32 ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    pin = pins [i] ;
+
+    if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
+    {
+      /**/ if (wiringPiMode == WPI_MODE_PINS)
+	pin = pinToGpio [pin] ;
+      else if (wiringPiMode == WPI_MODE_PHYS)
+	pin = physToGpio [pin] ;
+      else if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+      {
+	chipPins [chipCount]   = pin ;
+	chipBits [chipCount++] = i ;
+	continue ;
+      }
+      else if (wiringPiMode != WPI_MODE_GPIO)
+      {
+	if (digitalRead (pin) != LOW)
+	  value |= 1U << i ;
+	continue ;
+      }
+
+      bank = (pin >> 5) & 1 ;
+      if (!levelRead [bank])
+      {
+	level     [bank] = *(gpio + gpioToGPLEV [pin]) ;
+	levelRead [bank] = TRUE ;
+      }
 
-  if (freq == 0)
-    pwmWrite (pin, 0) ;             // Off
-  else
+      if ((level [bank] & (1 << (pin & 31))) != 0)
+	value |= 1U << i ;
+    }
+    else if ((node = wiringPiFindNode (pin)) != NULL)
+    {
+      if ((offset = pin - node->pinBase) < 32)
+      {
+	if (node != group)
+	{
+	  group      = node ;
+	  groupValue = node->digitalReadPort (node) ;
+	}
+	if (((groupValue >> offset) & 1) != 0)
+	  value |= 1U << i ;
+      }
+      else if (node->digitalRead (node, pin) != LOW)
+	value |= 1U << i ;
+    }
+  }
+
+  if (chipCount > 0)
   {
-    range = 600000 / freq ;
-    pwmSetRange (range) ;
-    pwmWrite    (pin, freq / 2) ;
+    chipReadMany (chipPins, chipValues, chipCount) ;
+    for (i = 0 ; i < chipCount ; ++i)
+      if (chipValues [i] != 0)
+	value |= 1U << chipBits [i] ;
   }
-}
 
+  return value ;
+}
 
 
 /*
- * digitalWriteByte:
- *	Pi Specific
- *	Write an 8-bit byte to the first 8 GPIO pins - try to do it as
- *	fast as possible.
- *	However it still needs 2 operations to set the bits, so any external
- *	hardware must not rely on seeing a change as there will be a change 
- *	to set the outputs bits to zero, then another change to set the 1's
+ * wiringPiPinRegs:
+ *	Work out the registers and bit for an on-board pin once, so that
+ *	time-critical bit-banging code can then drive it without going
+ *	through digitalWrite for every edge.
+ *	Returns FALSE if the pin isn't on-board or we've not got the GPIO
+ *	mapped (e.g. in sys mode)
  *********************************************************************************
  */
 
-void digitalWriteByte (int value)
+int wiringPiPinRegs (int pin, struct wpiPinRegs *regs)
 {
-  uint32_t pinSet = 0 ;
-  uint32_t pinClr = 0 ;
-  int mask = 1 ;
-  int pin ;
+  if ((pin & PI_GPIO_MASK) != 0)
+    return FALSE ;
 
-  /**/ if (wiringPiMode == WPI_MODE_GPIO_SYS)
-  {
-    for (pin = 0 ; pin < 8 ; ++pin)
-    {
-      digitalWrite (pin, value & mask) ;
-      mask <<= 1 ;
-    }
-    return ;
-  }
-  else
-  {
-    for (pin = 0 ; pin < 8 ; ++pin)
-    {
-      if ((value & mask) == 0)
-	pinClr |= (1 << pinToGpio [pin]) ;
-      else
-	pinSet |= (1 << pinToGpio [pin]) ;
+  /**/ if (wiringPiMode == WPI_MODE_PINS)
+    pin = pinToGpio [pin] ;
+  else if (wiringPiMode == WPI_MODE_PHYS)
+    pin = physToGpio [pin] ;
+  else if (wiringPiMode != WPI_MODE_GPIO)
+    return FALSE ;
 
-      mask <<= 1 ;
-    }
+  if ((pin < 0) || (pin > 63))
+    return FALSE ;
 
-    *(gpio + gpioToGPCLR [0]) = pinClr ;
-    *(gpio + gpioToGPSET [0]) = pinSet ;
-  }
+  regs->set  = gpio + gpioToGPSET [pin] ;
+  regs->clr  = gpio + gpioToGPCLR [pin] ;
+  regs->lev  = gpio + gpioToGPLEV [pin] ;
+  regs->mask = 1 << (pin & 31) ;
+
+  return TRUE ;
 }
 
 
@@ -1523,8 +2889,8 @@ void digitalWriteByte (int value)
  *	Pi Specific.
  *	Wait for Interrupt on a GPIO pin.
  *	This is actually done via the /sys/class/gpio interface regardless of
- *	the wiringPi access mode in-use. Maybe sometime it might get a better
- *	way for a bit more efficiency.
+ *	the wiringPi access mode in-use, unless we're using the GPIO
+ *	character device, when it's waitForEdge.
  *********************************************************************************
  */
 
@@ -1534,12 +2900,17 @@ int waitForInterrupt (int pin, int mS)
   uint8_t c ;
   struct pollfd polls ;
 
+  /**/ if (wiringPiMode == WPI_MODE_UNINITIALISED)	// Torn down
+    return -2 ;
+  else if (wiringPiMode == WPI_MODE_GPIO_CHIP)		// No sysfs needed
+    return waitForEdge (pin, mS, NULL) ;
+
   /**/ if (wiringPiMode == WPI_MODE_PINS)
     pin = pinToGpio [pin] ;
   else if (wiringPiMode == WPI_MODE_PHYS)
     pin = physToGpio [pin] ;
 
-  if ((fd = sysFds [pin]) == -1)
+  if ((fd = sysFd (pin & 63)) == -1)
     return -2 ;
 
 // Setup poll structure
@@ -1567,56 +2938,74 @@ int waitForInterrupt (int pin, int mS)
  *	This is a thread and gets started to wait for the interrupt we're
  *	hoping to catch. It will call the user-function when the interrupt
  *	fires.
+ *	It can only be cancelled (by wiringPiTeardown) while it's waiting,
+ *	never part-way through the user's function. It ends by itself once
+ *	there's nothing left to wait on (-2), e.g. after a teardown, or when
+ *	it's no longer the pin's thread - one cut loose by wiringPiTeardown
+ *	from its own handler.
  *********************************************************************************
  */
 
+static int isrCurrent (int pin)
+{
+  int current ;
+
+  pthread_mutex_lock (&pinMutex) ;
+    current = isrRunning [pin] && pthread_equal (isrThreads [pin], pthread_self ()) ;
+  pthread_mutex_unlock (&pinMutex) ;
+
+  return current ;
+}
+
 static void *interruptHandler (void *arg)
 {
-  int myPin ;
+  int myPin, x ;
 
   (void)piHiPri (55) ;	// Only effective if we run as root
 
   myPin   = pinPass ;
   pinPass = -1 ;
 
-  for (;;)
-    if (waitForInterrupt (myPin, -1) > 0)
-      isrFunctions [myPin] () ;
+  while (isrCurrent (myPin))
+  {
+    x = waitForInterrupt (myPin, -1) ;
+
+    if (x == -2)
+    {
+      pthread_mutex_lock (&pinMutex) ;
+	if (isrRunning [myPin] && pthread_equal (isrThreads [myPin], pthread_self ()))
+	  isrExited [myPin] = TRUE ;	// wiringPiISR joins us
+      pthread_mutex_unlock (&pinMutex) ;
+      break ;
+    }
+
+    if (x > 0)
+    {
+      pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, NULL) ;
+	isrFunctions [myPin] () ;
+      pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, NULL) ;
+    }
+  }
 
   return NULL ;
 }
 
 
 /*
- * wiringPiISR:
- *	Pi Specific.
- *	Take the details and create an interrupt handler that will do a call-
- *	back to the user supplied function.
+ * sysEdgeSetup:
+ *	Get the kernel to watch a pin for edges via /sys/class/gpio and
+ *	open its value file for waitForInterrupt.
  *********************************************************************************
  */
 
-int wiringPiISR (int pin, int mode, void (*function)(void))
+static int sysEdgeSetup (int bcmGpioPin, int mode)
 {
-  pthread_t threadId ;
   const char *modeS ;
   char fName   [64] ;
   char  pinS [8] ;
   pid_t pid ;
   int   count, i ;
   char  c ;
-  int   bcmGpioPin ;
-
-  if ((pin < 0) || (pin > 63))
-    return wiringPiFailure (WPI_FATAL, "wiringPiISR: pin must be 0-63 (%d)\n", pin) ;
-
-  /**/ if (wiringPiMode == WPI_MODE_UNINITIALISED)
-    return wiringPiFailure (WPI_FATAL, "wiringPiISR: wiringPi has not been initialised. Unable to continue.\n") ;
-  else if (wiringPiMode == WPI_MODE_PINS)
-    bcmGpioPin = pinToGpio [pin] ;
-  else if (wiringPiMode == WPI_MODE_PHYS)
-    bcmGpioPin = physToGpio [pin] ;
-  else
-    bcmGpioPin = pin ;
 
 // Now export the pin and set the right edge
 //	We're going to use the gpio program to do this, so it assumes
@@ -1660,7 +3049,7 @@ int wiringPiISR (int pin, int mode, void (*function)(void))
 // Now pre-open the /sys/class node - but it may already be open if
 //	we are in Sys mode...
 
-  if (sysFds [bcmGpioPin] == -1)
+  if (sysFds [bcmGpioPin] < 0)		// Just exported it, so try again
   {
     sprintf (fName, "/sys/class/gpio/gpio%d/value", bcmGpioPin) ;
     if ((sysFds [bcmGpioPin] = open (fName, O_RDWR)) < 0)
@@ -1673,13 +3062,72 @@ int wiringPiISR (int pin, int mode, void (*function)(void))
   for (i = 0 ; i < count ; ++i)
     read (sysFds [bcmGpioPin], &c, 1) ;
 
+  return 0 ;
+}
+
+
+/*
+ * wiringPiISR:
+ *	Pi Specific.
+ *	Take the details and create an interrupt handler that will do a call-
+ *	back to the user supplied function.
+ *	Calling it again for the same pin changes the edge and the function;
+ *	the pin keeps its one thread.
+ *********************************************************************************
+ */
+
+int wiringPiISR (int pin, int mode, void (*function)(void))
+{
+  pthread_t threadId ;
+  int   bcmGpioPin ;
+
+  if ((pin < 0) || (pin > 63))
+    return wiringPiFailure (WPI_FATAL, "wiringPiISR: pin must be 0-63 (%d)\n", pin) ;
+
+  /**/ if (wiringPiMode == WPI_MODE_UNINITIALISED)
+    return wiringPiFailure (WPI_FATAL, "wiringPiISR: wiringPi has not been initialised. Unable to continue.\n") ;
+  else if (wiringPiMode == WPI_MODE_PINS)
+    bcmGpioPin = pinToGpio [pin] ;
+  else if (wiringPiMode == WPI_MODE_PHYS)
+    bcmGpioPin = physToGpio [pin] ;
+  else
+    bcmGpioPin = pin ;
+
+// With the GPIO character device the kernel does it all for us,
+//	otherwise it's /sys/class/gpio
+
+  if (wiringPiMode == WPI_MODE_GPIO_CHIP)
+  {
+    if ((mode != INT_EDGE_SETUP) && (wiringPiGpioChipEdge (bcmGpioPin, mode) < 0))
+      return wiringPiFailure (WPI_FATAL, "wiringPiISR: unable to watch GPIO %d for edges: %s\n", bcmGpioPin, strerror (errno)) ;
+    if (chipEvents [bcmGpioPin] == -1)
+      return wiringPiFailure (WPI_FATAL, "wiringPiISR: GPIO %d is not being watched for edges\n", bcmGpioPin) ;
+  }
+  else if (sysEdgeSetup (bcmGpioPin, mode) < 0)
+    return -1 ;
+
   isrFunctions [pin] = function ;
 
   pthread_mutex_lock (&pinMutex) ;
-    pinPass = pin ;
-    pthread_create (&threadId, NULL, interruptHandler, NULL) ;
-    while (pinPass != -1)
-      delay (1) ;
+    if (isrRunning [pin] && isrExited [pin])
+    {
+      pthread_join (isrThreads [pin], NULL) ;
+      isrRunning [pin] = FALSE ;
+    }
+
+    if (!isrRunning [pin])
+    {
+      isrExited [pin] = FALSE ;
+      pinPass = pin ;
+      if (pthread_create (&threadId, NULL, interruptHandler, NULL) == 0)
+      {
+	isrThreads [pin] = threadId ;
+	isrRunning [pin] = TRUE ;
+	while (pinPass != -1)
+	  delay (1) ;
+      }
+      pinPass = -1 ;
+    }
   pthread_mutex_unlock (&pinMutex) ;
 
   return 0 ;
@@ -1814,14 +3262,16 @@ unsigned int micros (void)
  *	memory mapped hardware directly.
  *
  * Changed now to revert to "gpio" mode if we're running on a Compute Module.
+ *
+ * If we can't tell what board this is it returns -1 rather than exiting,
+ *	whether WIRINGPI_CODES is set or not.
  *********************************************************************************
  */
 
 int wiringPiSetup (void)
 {
   int   fd ;
-  int   boardRev ;
-  int   model, rev, mem, maker, overVolted ;
+  void *map ;
 
   if (getenv (ENV_DEBUG) != NULL)
     wiringPiDebug = TRUE ;
@@ -1829,78 +3279,77 @@ int wiringPiSetup (void)
   if (getenv (ENV_CODES) != NULL)
     wiringPiReturnCodes = TRUE ;
 
-  if (geteuid () != 0)
-    (void)wiringPiFailure (WPI_FATAL, "wiringPiSetup: Must be root. (Did you forget sudo?)\n") ;
-
   if (wiringPiDebug)
     printf ("wiringPi: wiringPiSetup called\n") ;
 
-  boardRev = piBoardRev () ;
+// Not knowing the board isn't fatal - it may not be a Pi at all, and
+//	the caller can carry on without us, so always just say so.
 
-  /**/ if (boardRev == 1)	// A, B, Rev 1, 1.1
-  {
-     pinToGpio =  pinToGpioR1 ;
-    physToGpio = physToGpioR1 ;
-  }
-  else 				// A, B, Rev 2, B+, CM, Pi2
+  if (piBoardRev () < 0)
   {
-    if (piModel2)
-      BCM2708_PERI_BASE = 0x3F000000 ;
-     pinToGpio =  pinToGpioR2 ;
-    physToGpio = physToGpioR2 ;
+    fprintf (stderr, "wiringPiSetup: Unable to determine the board type\n") ;
+    return -1 ;
   }
 
-// Open the master /dev/memory device
+   pinToGpio        = piBoard.pinToGpio ;
+  physToGpio        = piBoard.physToGpio ;
+  BCM2708_PERI_BASE = piBoard.periBase ;
 
-  if ((fd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
-    return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: Unable to open /dev/mem: %s\n", strerror (errno)) ;
+// Only map the hardware the once - we may be called again via
+//	wiringPiSetupGpio, etc. or by something else in the same program.
 
-// GPIO:
+  if (gpio == NULL)
+  {
 
-  gpio = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_BASE) ;
-  if ((int32_t)gpio == -1)
-    return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
+// Open the master /dev/memory device, or if we're not root then try the
+//	GPIO-only /dev/gpiomem. That's all we need for most things, but
+//	PWM, the clocks and pad drive will need root.
 
-// PWM
+    if (geteuid () == 0)
+    {
+      if ((fd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
+	return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: Unable to open /dev/mem: %s\n", strerror (errno)) ;
+      gpioMem = FALSE ;
+    }
+    else
+    {
+      if ((fd = open ("/dev/gpiomem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
+	return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: Must be root, or have access to /dev/gpiomem. (Did you forget sudo?)\n") ;
+      gpioMem = TRUE ;
+    }
 
-  pwm = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_PWM) ;
-  if ((int32_t)pwm == -1)
-    return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (PWM) failed: %s\n", strerror (errno)) ;
- 
-// Clock control (needed for PWM)
+// GPIO:
 
-  clk = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, CLOCK_BASE) ;
-  if ((int32_t)clk == -1)
-    return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (CLOCK) failed: %s\n", strerror (errno)) ;
- 
-// The drive pads
+    if ((map = mmap (0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, gpioMem ? 0 : GPIO_BASE)) == MAP_FAILED)
+    {
+      close (fd) ;
+      return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
+    }
 
-  pads = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_PADS) ;
-  if ((int32_t)pads == -1)
-    return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (PADS) failed: %s\n", strerror (errno)) ;
+    gpio  = (volatile uint32_t *)map ;
+    memFd = fd ;
 
 #ifdef	USE_TIMER
 // The system timer
 
-  timer = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_TIMER) ;
-  if ((int32_t)timer == -1)
-    return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: mmap (TIMER) failed: %s\n", strerror (errno)) ;
+    if (!mapBlock (&timer, GPIO_TIMER, "TIMER"))
+      return -1 ;
 
 // Set the timer to free-running, 1MHz.
 //	0xF9 is 249, the timer divide is base clock / (divide+1)
 //	so base clock is 250MHz / 250 = 1MHz.
 
-  *(timer + TIMER_CONTROL) = 0x0000280 ;
-  *(timer + TIMER_PRE_DIV) = 0x00000F9 ;
-  timerIrqRaw = timer + TIMER_IRQ_RAW ;
+    *(timer + TIMER_CONTROL) = 0x0000280 ;
+    *(timer + TIMER_PRE_DIV) = 0x00000F9 ;
+    timerIrqRaw = timer + TIMER_IRQ_RAW ;
 #endif
 
-  initialiseEpoch () ;
+    initialiseEpoch () ;
+  }
 
 // If we're running on a compute module, then wiringPi pin numbers don't really many anything...
 
-  piBoardId (&model, &rev, &mem, &maker, &overVolted) ;
-  if (model == PI_MODEL_CM)
+  if (piBoard.model == PI_MODEL_CM)
     wiringPiMode = WPI_MODE_GPIO ;
   else
     wiringPiMode = WPI_MODE_PINS ;
@@ -1909,6 +3358,93 @@ int wiringPiSetup (void)
 }
 
 
+/*
+ * wiringPiTeardown:
+ *	Undo the setup: unmap all the hardware and close everything we
+ *	opened, so a later wiringPiSetup starts afresh.
+ *	The wiringPiISR threads are stopped first (waiting for any handler
+ *	that's running to finish), so they need setting up again afterwards.
+ *	Anything holding on to register pointers from wiringPiPinRegs -
+ *	including the piNes and ds1302 drivers - must not use them after
+ *	this; set those devices up again once wiringPi is.
+ *********************************************************************************
+ */
+
+void wiringPiTeardown (void)
+{
+  pthread_t threads [64] ;
+  int pin, count = 0 ;
+
+  if (wiringPiDebug)
+    printf ("wiringPi: wiringPiTeardown called\n") ;
+
+// Stop the interrupt threads before we close the fds they're waiting on.
+//	One of them calling us from its handler can't wait for itself, so
+//	it's cut loose instead - it's no longer the pin's thread, so it ends
+//	when its handler returns. The rest are stopped outside the lock, as
+//	a handler (running, so not cancellable yet) may want it.
+
+  pthread_mutex_lock (&pinMutex) ;
+    for (pin = 0 ; pin < 64 ; ++pin)
+    {
+      if (!isrRunning [pin])
+	continue ;
+
+      if (pthread_equal (isrThreads [pin], pthread_self ()))
+	pthread_detach (isrThreads [pin]) ;
+      else
+	threads [count++] = isrThreads [pin] ;
+
+      isrRunning [pin] = FALSE ;
+      isrExited  [pin] = FALSE ;
+    }
+  pthread_mutex_unlock (&pinMutex) ;
+
+  for (pin = 0 ; pin < count ; ++pin)
+  {
+    pthread_cancel (threads [pin]) ;
+    pthread_join   (threads [pin], NULL) ;
+  }
+
+  wiringPiMode = WPI_MODE_UNINITIALISED ;
+
+  if (gpio != NULL) { munmap ((void *)gpio, BLOCK_SIZE) ; gpio = NULL ; }
+  if (pwm  != NULL) { munmap ((void *)pwm,  BLOCK_SIZE) ; pwm  = NULL ; }
+  if (clk  != NULL) { munmap ((void *)clk,  BLOCK_SIZE) ; clk  = NULL ; }
+  if (pads != NULL) { munmap ((void *)pads, BLOCK_SIZE) ; pads = NULL ; }
+#ifdef	USE_TIMER
+  if (timer != NULL) { munmap ((void *)timer, BLOCK_SIZE) ; timer = NULL ; timerIrqRaw = NULL ; }
+#endif
+
+  if (memFd != -1)
+  {
+    close (memFd) ;
+    memFd = -1 ;
+  }
+
+  for (pin = 0 ; pin < 64 ; ++pin)
+  {
+    if (sysFds [pin] >= 0)
+      close (sysFds [pin]) ;
+    sysFds [pin] = -1 ;
+  }
+
+  if (chipFd != -1)
+  {
+    if (chipGroup.fd != -1)
+    {
+      close (chipGroup.fd) ;
+      chipGroup.fd = -1 ;
+    }
+    for (pin = 0 ; pin < 64 ; ++pin)
+      chipRelease (pin) ;
+    close (chipFd) ;
+    chipFd    = -1 ;
+    chipLines =  0 ;
+  }
+}
+
+
 /*
  * wiringPiSetupGpio:
  *	Must be called once at the start of your program execution.
@@ -1920,7 +3456,8 @@ int wiringPiSetup (void)
 
 int wiringPiSetupGpio (void)
 {
-  (void)wiringPiSetup () ;
+  if (wiringPiSetup () < 0)
+    return -1 ;
 
   if (wiringPiDebug)
     printf ("wiringPi: wiringPiSetupGpio called\n") ;
@@ -1942,7 +3479,8 @@ int wiringPiSetupGpio (void)
 
 int wiringPiSetupPhys (void)
 {
-  (void)wiringPiSetup () ;
+  if (wiringPiSetup () < 0)
+    return -1 ;
 
   if (wiringPiDebug)
     printf ("wiringPi: wiringPiSetupPhys called\n") ;
@@ -1964,9 +3502,7 @@ int wiringPiSetupPhys (void)
 
 int wiringPiSetupSys (void)
 {
-  int boardRev ;
   int pin ;
-  char fName [128] ;
 
   if (getenv (ENV_DEBUG) != NULL)
     wiringPiDebug = TRUE ;
@@ -1977,27 +3513,22 @@ int wiringPiSetupSys (void)
   if (wiringPiDebug)
     printf ("wiringPi: wiringPiSetupSys called\n") ;
 
-  boardRev = piBoardRev () ;
-
-  if (boardRev == 1)
-  {
-     pinToGpio =  pinToGpioR1 ;
-    physToGpio = physToGpioR1 ;
-  }
-  else
+  if (piBoardRev () < 0)
   {
-     pinToGpio =  pinToGpioR2 ;
-    physToGpio = physToGpioR2 ;
+    fprintf (stderr, "wiringPiSetupSys: Unable to determine the board type\n") ;
+    return -1 ;
   }
 
-// Open and scan the directory, looking for exported GPIOs, and pre-open
-//	the 'value' interface to speed things up for later
-  
+   pinToGpio = piBoard.pinToGpio ;
+  physToGpio = piBoard.physToGpio ;
+
+// The 'value' files for exported GPIOs are opened as they're first used.
+//	Have another go at any that weren't there last time - they may have
+//	been exported since.
+
   for (pin = 0 ; pin < 64 ; ++pin)
-  {
-    sprintf (fName, "/sys/class/gpio/gpio%d/value", pin) ;
-    sysFds [pin] = open (fName, O_RDWR) ;
-  }
+    if (sysFds [pin] == SYS_FD_MISSING)
+      sysFds [pin] = -1 ;
 
   initialiseEpoch () ;
 
@@ -2005,3 +3536,92 @@ int wiringPiSetupSys (void)
 
   return 0 ;
 }
+
+
+/*
+ * wiringPiSetupGpioChip:
+ *	Must be called once at the start of your program execution.
+ *
+ * Initialisation using the GPIO character device, /dev/gpiochipN. Pins
+ *	are the native GPIO numbers, as in Sys mode, but it needs neither
+ *	root nor /sys/class/gpio and is a lot quicker. We use the chip that
+ *	drives the Pi's header, or the first one we find if it's not there.
+ *********************************************************************************
+ */
+
+int wiringPiSetupGpioChip (void)
+{
+  struct gpiochip_info info ;
+  char fName [32] ;
+  int  fd, chip, pin ;
+
+  if (getenv (ENV_DEBUG) != NULL)
+    wiringPiDebug = TRUE ;
+
+  if (getenv (ENV_CODES) != NULL)
+    wiringPiReturnCodes = TRUE ;
+
+  if (wiringPiDebug)
+    printf ("wiringPi: wiringPiSetupGpioChip called\n") ;
+
+  if (chipFd == -1)
+  {
+    for (chip = 0 ; chip < 16 ; ++chip)
+    {
+      sprintf (fName, "/dev/gpiochip%d", chip) ;
+      if ((fd = open (fName, O_RDWR | O_CLOEXEC)) < 0)
+	continue ;
+
+      if (ioctl (fd, GPIO_GET_CHIPINFO_IOCTL, &info) < 0)
+      {
+	close (fd) ;
+	continue ;
+      }
+
+      if (wiringPiDebug)
+	printf ("wiringPiSetupGpioChip: %s: %s, %d lines\n", fName, info.label, info.lines) ;
+
+      if (strncmp (info.label, "pinctrl-bcm", 11) == 0)	// The Pi's own GPIO
+      {
+	if (chipFd != -1)
+	  close (chipFd) ;
+	chipFd    = fd ;
+	chipLines = info.lines ;
+	break ;
+      }
+
+      if (chipFd == -1)
+      {
+	chipFd    = fd ;
+	chipLines = info.lines ;
+      }
+      else
+	close (fd) ;
+    }
+
+    if (chipFd == -1)
+      return wiringPiFailure (WPI_ALMOST, "wiringPiSetupGpioChip: Unable to open a /dev/gpiochip device\n") ;
+
+    if (chipLines > 64)
+      chipLines = 64 ;
+
+    for (pin = 0 ; pin < 64 ; ++pin)
+    {
+      chipHandles [pin] = -1 ;
+      chipOutput  [pin] = FALSE ;
+      chipValue   [pin] = LOW ;
+      chipBias    [pin] =  0 ;
+      chipEvents  [pin] = -1 ;
+      chipEdges   [pin] = INT_EDGE_SETUP ;
+      chipWake    [pin] = -1 ;
+      chipWaiters [pin] =  0 ;
+      chipBusy    [pin] = FALSE ;
+    }
+
+    initialiseEpoch () ;
+  }
+
+  wiringPiMode = WPI_MODE_GPIO_CHIP ;
+
+  return 0 ;
+}
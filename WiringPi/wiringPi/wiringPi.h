@@ -34,6 +34,7 @@
 #define	WPI_MODE_GPIO_SYS	 2
 #define	WPI_MODE_PHYS		 3
 #define	WPI_MODE_PIFACE		 4
+#define	WPI_MODE_GPIO_CHIP	 5
 #define	WPI_MODE_UNINITIALISED	-1
 
 // Pin modes
@@ -107,6 +108,52 @@ extern const char *piMakerNames    [5] ;
 #define	WPI_ALMOST	(1==2)
 
 
+// wpiSample:
+//	An analog reading along with what's needed to make sense of it.
+//	value is raw * scale + offset, in the given units.
+
+struct wpiSample
+{
+  int          raw ;		// As read from the device, sign extended
+  int          bits ;		// Resolution of raw, 0 if not known
+  double       scale ;		// Units per count
+  double       offset ;
+  double       value ;
+  const char  *units ;		// "V", "C" or "" if the node doesn't know
+  unsigned int timestamp ;	// micros () when the sample was taken
+  unsigned int flags ;		// WPI_SAMPLE_xxx below
+} ;
+
+#define	WPI_SAMPLE_ERROR	0x01	// Unable to read the device
+#define	WPI_SAMPLE_OVERRANGE	0x02	// Reading clipped at full scale
+#define	WPI_SAMPLE_OPEN		0x04	// Sensor open circuit
+#define	WPI_SAMPLE_SHORT	0x08	// Sensor shorted
+
+
+// wpiPinRegs:
+//	Where an on-board pin lives in the GPIO registers, for code that
+//	needs to bang the pin directly - see wiringPiPinRegs ()
+//	The pointers are only good until wiringPiTeardown ()
+
+struct wpiPinRegs
+{
+  volatile unsigned int *set ;		// Write mask to set the pin high
+  volatile unsigned int *clr ;		// Write mask to set it low
+  volatile unsigned int *lev ;		// Read & mask for its level
+  unsigned int           mask ;
+} ;
+
+
+// wpiEdge:
+//	An edge seen on a pin by the GPIO character device
+
+struct wpiEdge
+{
+  unsigned long long timestamp ;	// When it happened, in nS, by the kernel's clock
+  int                rising ;		// TRUE for a rising edge, FALSE falling
+} ;
+
+
 // wiringPiNodeStruct:
 //	This describes additional device nodes in the extended wiringPi
 //	2.0 scheme of things.
@@ -126,6 +173,9 @@ struct wiringPiNodeStruct
   unsigned int data2 ;	//  ditto
   unsigned int data3 ;	//  ditto
 
+  int          deferred ;	// Write coalescing enabled
+  unsigned int dirty ;		// Bitmap of ports with pending writes
+
   void   (*pinMode)         (struct wiringPiNodeStruct *node, int pin, int mode) ;
   void   (*pullUpDnControl) (struct wiringPiNodeStruct *node, int pin, int mode) ;
   int    (*digitalRead)     (struct wiringPiNodeStruct *node, int pin) ;
@@ -133,6 +183,12 @@ struct wiringPiNodeStruct
   void   (*pwmWrite)        (struct wiringPiNodeStruct *node, int pin, int value) ;
   int    (*analogRead)      (struct wiringPiNodeStruct *node, int pin) ;
   void   (*analogWrite)     (struct wiringPiNodeStruct *node, int pin, int value) ;
+  void   (*flush)           (struct wiringPiNodeStruct *node) ;
+  int    (*analogReadEx)    (struct wiringPiNodeStruct *node, int pin, struct wpiSample *sample) ;
+  int    (*analogReadMany)  (struct wiringPiNodeStruct *node, const int *chans, struct wpiSample *out, int n) ;
+
+  unsigned int (*digitalReadPort)  (struct wiringPiNodeStruct *node) ;
+  void         (*digitalWritePort) (struct wiringPiNodeStruct *node, unsigned int mask, unsigned int value) ;
 
   struct wiringPiNodeStruct *next ;
 } ;
@@ -153,16 +209,21 @@ extern "C" {
 // Internal
 
 extern int wiringPiFailure (int fatal, const char *message, ...) ;
+extern void wiringPiSampleSet (struct wpiSample *sample, int raw, int bits, double scale, double offset, const char *units) ;
 
 // Core wiringPi functions
 
 extern struct wiringPiNodeStruct *wiringPiFindNode (int pin) ;
 extern struct wiringPiNodeStruct *wiringPiNewNode  (int pinBase, int numPins) ;
+extern void wiringPiNodeDefer   (int pinBase, int defer) ;
+extern void wiringPiNodeFlush   (int pinBase) ;
 
 extern int  wiringPiSetup       (void) ;
 extern int  wiringPiSetupSys    (void) ;
 extern int  wiringPiSetupGpio   (void) ;
 extern int  wiringPiSetupPhys   (void) ;
+extern int  wiringPiSetupGpioChip (void) ;
+extern void wiringPiTeardown    (void) ;
 
 extern void pinModeAlt          (int pin, int mode) ;
 extern void pinMode             (int pin, int mode) ;
@@ -172,6 +233,13 @@ extern void digitalWrite        (int pin, int value) ;
 extern void pwmWrite            (int pin, int value) ;
 extern int  analogRead          (int pin) ;
 extern void analogWrite         (int pin, int value) ;
+extern int  analogReadEx        (int pin, struct wpiSample *sample) ;
+extern int  analogReadMany      (int pinBase, const int *chans, struct wpiSample *out, int n) ;
+
+extern void         digitalWriteMany (const int *pins, int count, unsigned int value) ;
+extern unsigned int digitalReadMany  (const int *pins, int count) ;
+extern unsigned int digitalReadNode  (int pinBase) ;
+extern void         digitalWriteNode (int pinBase, unsigned int mask, unsigned int value) ;
 
 // PiFace specifics 
 //	(Deprecated)
@@ -193,11 +261,20 @@ extern void pwmSetMode          (int mode) ;
 extern void pwmSetRange         (unsigned int range) ;
 extern void pwmSetClock         (int divisor) ;
 extern void gpioClockSet        (int pin, int freq) ;
+extern int  wiringPiPinRegs     (int pin, struct wpiPinRegs *regs) ;
+
+// GPIO character device - after wiringPiSetupGpioChip
+
+extern int  wiringPiGpioChipLines (const int *pins, int count, int mode) ;
+extern int  wiringPiGpioChipRead  (int handle, unsigned char *values, int count) ;
+extern int  wiringPiGpioChipWrite (int handle, const unsigned char *values, int count) ;
+extern int  wiringPiGpioChipEdge  (int pin, int edgeType) ;
 
 // Interrupts
 //	(Also Pi hardware specific)
 
 extern int  waitForInterrupt    (int pin, int mS) ;
+extern int  waitForEdge         (int pin, int mS, struct wpiEdge *edge) ;
 extern int  wiringPiISR         (int pin, int mode, void (*function)(void)) ;
 
 // Threads
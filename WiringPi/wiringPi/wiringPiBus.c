@@ -0,0 +1,272 @@
+/*
+ * wiringPiBus.c:
+ *	Arbitrate access to the shared I2C and SPI buses between threads
+ *	Copyright (c) 2015 Gordon Henderson
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://projects.drogon.net/raspberry-pi/wiringpi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+/*
+ * Notes:
+ *	The kernel keeps each individual I2C/SPI transfer in one piece, but
+ *	that's not enough when several threads (softPwm, ISRs, the main
+ *	program) all talk to devices on the same bus: a read-modify-write
+ *	of an expander register is two transfers, and another thread can
+ *	get in between them.
+ *
+ *	So every transfer takes the bus lock here, and the device drivers
+ *	take it around their multi-transfer sequences. The lock is
+ *	recursive for the thread holding it. When the bus is released, the
+ *	waiter with the highest priority (set per-thread with
+ *	wiringPiBusPriority) gets it next.
+ *********************************************************************************
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "wiringPi.h"
+#include "wiringPiBus.h"
+
+#ifndef	TRUE
+#define	TRUE	(1==1)
+#define	FALSE	(1==2)
+#endif
+
+#define	NUM_PRIORITIES	(WPI_BUS_PRI_URGENT + 1)
+
+struct busStruct
+{
+  pthread_mutex_t mutex ;
+  pthread_cond_t  cond ;
+
+  int       held ;			// Recursion depth of the owner
+  pthread_t owner ;
+  int       waiting [NUM_PRIORITIES] ;
+
+// Stats
+
+  uint64_t  firstUsed ;
+  uint64_t  lockedAt ;
+  struct wiringPiBusStatsStruct stats ;
+} ;
+
+static pthread_once_t   busOnce = PTHREAD_ONCE_INIT ;
+static struct busStruct buses [WPI_MAX_BUSES] ;
+
+static __thread int threadPriority = WPI_BUS_PRI_NORMAL ;
+
+
+/*
+ * nowMicros:
+ *	Monotonic time in microseconds for the stats
+ *********************************************************************************
+ */
+
+static uint64_t nowMicros (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+
+  return (uint64_t)ts.tv_sec * (uint64_t)1000000 + (uint64_t)(ts.tv_nsec / 1000) ;
+}
+
+
+/*
+ * busInit:
+ *	One-time setup of the bus locks
+ *********************************************************************************
+ */
+
+static void busInit (void)
+{
+  int i ;
+
+  for (i = 0 ; i < WPI_MAX_BUSES ; ++i)
+  {
+    pthread_mutex_init (&buses [i].mutex, NULL) ;
+    pthread_cond_init  (&buses [i].cond,  NULL) ;
+  }
+}
+
+
+/*
+ * higherWaiting:
+ *	Is anyone waiting for the bus at a higher priority than us?
+ *********************************************************************************
+ */
+
+static int higherWaiting (struct busStruct *bus, int priority)
+{
+  int pri ;
+
+  for (pri = priority + 1 ; pri < NUM_PRIORITIES ; ++pri)
+    if (bus->waiting [pri] != 0)
+      return TRUE ;
+
+  return FALSE ;
+}
+
+
+/*
+ * wiringPiBusPriority:
+ *	Set the priority the calling thread uses when waiting for a bus.
+ *	Returns the old value.
+ *********************************************************************************
+ */
+
+int wiringPiBusPriority (int priority)
+{
+  int old = threadPriority ;
+
+  /**/ if (priority < WPI_BUS_PRI_LOW)
+    priority = WPI_BUS_PRI_LOW ;
+  else if (priority > WPI_BUS_PRI_URGENT)
+    priority = WPI_BUS_PRI_URGENT ;
+
+  threadPriority = priority ;
+
+  return old ;
+}
+
+
+/*
+ * wiringPiBusLock: wiringPiBusUnlock:
+ *	Take and release a bus. Calls nest within the one thread, so a
+ *	driver can hold the bus over a sequence of transfers which each
+ *	take it themselves.
+ *********************************************************************************
+ */
+
+void wiringPiBusLock (int bus)
+{
+  struct busStruct *b ;
+  uint64_t start, waited ;
+  int pri = threadPriority ;
+
+  pthread_once (&busOnce, busInit) ;
+
+  b = &buses [bus & (WPI_MAX_BUSES - 1)] ;
+
+  pthread_mutex_lock (&b->mutex) ;
+
+  if ((b->held != 0) && pthread_equal (b->owner, pthread_self ()))
+  {
+    ++b->held ;
+    pthread_mutex_unlock (&b->mutex) ;
+    return ;
+  }
+
+  start = nowMicros () ;
+
+  if ((b->held != 0) || higherWaiting (b, pri))
+  {
+    ++b->stats.contended ;
+    ++b->waiting [pri] ;
+      while ((b->held != 0) || higherWaiting (b, pri))
+	pthread_cond_wait (&b->cond, &b->mutex) ;
+    --b->waiting [pri] ;
+  }
+
+  b->held     = 1 ;
+  b->owner    = pthread_self () ;
+  b->lockedAt = nowMicros () ;
+
+  if (b->firstUsed == 0)
+    b->firstUsed = start ;
+
+  waited = b->lockedAt - start ;
+  ++b->stats.transactions ;
+  b->stats.waitMicros += waited ;
+  if (waited > b->stats.maxWaitMicros)
+    b->stats.maxWaitMicros = (unsigned int)waited ;
+
+  pthread_mutex_unlock (&b->mutex) ;
+}
+
+void wiringPiBusUnlock (int bus)
+{
+  struct busStruct *b ;
+
+  pthread_once (&busOnce, busInit) ;
+
+  b = &buses [bus & (WPI_MAX_BUSES - 1)] ;
+
+  pthread_mutex_lock (&b->mutex) ;
+
+  if ((b->held != 0) && pthread_equal (b->owner, pthread_self ()))
+  {
+    if (--b->held == 0)
+    {
+      b->stats.busyMicros += nowMicros () - b->lockedAt ;
+      pthread_cond_broadcast (&b->cond) ;
+    }
+  }
+
+  pthread_mutex_unlock (&b->mutex) ;
+}
+
+
+/*
+ * wiringPiBusStats: wiringPiBusResetStats:
+ *	Return (or clear) the usage and wait-time counters for a bus
+ *********************************************************************************
+ */
+
+int wiringPiBusStats (int bus, struct wiringPiBusStatsStruct *stats)
+{
+  struct busStruct *b ;
+  uint64_t elapsed ;
+
+  if ((bus < 0) || (bus >= WPI_MAX_BUSES))
+    return -1 ;
+
+  pthread_once (&busOnce, busInit) ;
+
+  b = &buses [bus] ;
+
+  pthread_mutex_lock (&b->mutex) ;
+    *stats  = b->stats ;
+    elapsed = (b->firstUsed == 0) ? 0 : nowMicros () - b->firstUsed ;
+  pthread_mutex_unlock (&b->mutex) ;
+
+  stats->utilisation = (elapsed == 0) ? 0.0 : (double)stats->busyMicros / (double)elapsed ;
+
+  return 0 ;
+}
+
+void wiringPiBusResetStats (int bus)
+{
+  struct busStruct *b ;
+
+  if ((bus < 0) || (bus >= WPI_MAX_BUSES))
+    return ;
+
+  pthread_once (&busOnce, busInit) ;
+
+  b = &buses [bus] ;
+
+  pthread_mutex_lock (&b->mutex) ;
+    memset (&b->stats, 0, sizeof (b->stats)) ;
+    b->firstUsed = 0 ;
+  pthread_mutex_unlock (&b->mutex) ;
+}
@@ -0,0 +1,61 @@
+/*
+ * wiringPiBus.h:
+ *	Arbitrate access to the shared I2C and SPI buses between threads
+ *	Copyright (c) 2015 Gordon Henderson
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://projects.drogon.net/raspberry-pi/wiringpi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+// Bus numbers
+
+#define	WPI_MAX_BUSES		16
+
+#define	WPI_BUS_I2C(n)		((n) & 7)
+#define	WPI_BUS_SPI(n)		(8 + ((n) & 7))
+
+// Priorities - a waiting thread at a higher priority gets the bus first
+
+#define	WPI_BUS_PRI_LOW		0
+#define	WPI_BUS_PRI_NORMAL	1
+#define	WPI_BUS_PRI_HIGH	2
+#define	WPI_BUS_PRI_URGENT	3
+
+struct wiringPiBusStatsStruct
+{
+  unsigned long long transactions ;	// Times the bus was taken
+  unsigned long long contended ;	//  ... and of those, how many had to wait
+  unsigned long long busyMicros ;	// Total time the bus was held
+  unsigned long long waitMicros ;	// Total time spent waiting for it
+  unsigned int       maxWaitMicros ;
+  double             utilisation ;	// busyMicros / time since first use
+} ;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int  wiringPiBusPriority (int priority) ;
+extern void wiringPiBusLock     (int bus) ;
+extern void wiringPiBusUnlock   (int bus) ;
+extern int  wiringPiBusStats    (int bus, struct wiringPiBusStatsStruct *stats) ;
+extern void wiringPiBusResetStats (int bus) ;
+
+#ifdef __cplusplus
+}
+#endif
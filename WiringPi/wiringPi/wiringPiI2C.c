@@ -52,8 +52,11 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 
 #include "wiringPi.h"
+#include "wiringPiBus.h"
 #include "wiringPiI2C.h"
 
 // I2C definitions
@@ -98,15 +101,71 @@ struct i2c_smbus_ioctl_data
   union i2c_smbus_data *data ;
 } ;
 
+// Which bus each open fd is on - stored as bus + 1 so 0 is unknown
+
+#define	MAX_I2C_FDS	256
+
+static uint8_t i2cBusForFd [MAX_I2C_FDS] ;
+
+
+/*
+ * i2cBus:
+ *	Work out which I2C bus an fd belongs to. The minor number of an
+ *	i2c-dev node is the adapter number. We remember it at setup time,
+ *	but cope with fds we've not seen before too.
+ *********************************************************************************
+ */
+
+static int i2cBus (int fd)
+{
+  struct stat st ;
+
+  if ((fd >= 0) && (fd < MAX_I2C_FDS) && (i2cBusForFd [fd] != 0))
+    return i2cBusForFd [fd] - 1 ;
+
+  if ((fstat (fd, &st) == 0) && S_ISCHR (st.st_mode))
+    return WPI_BUS_I2C (minor (st.st_rdev)) ;
+
+  return WPI_BUS_I2C (0) ;
+}
+
+
+/*
+ * wiringPiI2CLock: wiringPiI2CUnlock:
+ *	Hold the bus the device is on across several transfers, e.g. for a
+ *	read-modify-write of a register. Every transfer below takes the lock
+ *	for itself anyway; these calls nest.
+ *********************************************************************************
+ */
+
+void wiringPiI2CLock (int fd)
+{
+  wiringPiBusLock (i2cBus (fd)) ;
+}
+
+void wiringPiI2CUnlock (int fd)
+{
+  wiringPiBusUnlock (i2cBus (fd)) ;
+}
+
+
 static inline int i2c_smbus_access (int fd, char rw, uint8_t command, int size, union i2c_smbus_data *data)
 {
   struct i2c_smbus_ioctl_data args ;
+  int bus, result ;
 
   args.read_write = rw ;
   args.command    = command ;
   args.size       = size ;
   args.data       = data ;
-  return ioctl (fd, I2C_SMBUS, &args) ;
+
+  bus = i2cBus (fd) ;
+
+  wiringPiBusLock (bus) ;
+    result = ioctl (fd, I2C_SMBUS, &args) ;
+  wiringPiBusUnlock (bus) ;
+
+  return result ;
 }
 
 
@@ -189,6 +248,29 @@ int wiringPiI2CWriteReg16 (int fd, int reg, int value)
 }
 
 
+/*
+ * wiringPiI2CWriteBlock:
+ *	Write up to 32 bytes to consecutive registers, starting at reg, in
+ *	a single transfer - for devices that auto-increment the register.
+ *********************************************************************************
+ */
+
+int wiringPiI2CWriteBlock (int fd, int reg, const unsigned char *values, int len)
+{
+  union i2c_smbus_data data ;
+  int i ;
+
+  if ((len < 1) || (len > I2C_SMBUS_I2C_BLOCK_MAX))
+    return -1 ;
+
+  data.block [0] = len ;
+  for (i = 0 ; i < len ; ++i)
+    data.block [i + 1] = values [i] ;
+
+  return i2c_smbus_access (fd, I2C_SMBUS_WRITE, reg, I2C_SMBUS_I2C_BLOCK_DATA, &data) ;
+}
+
+
 /*
  * wiringPiI2CSetupInterface:
  *	Undocumented access to set the interface explicitly - might be used
@@ -199,6 +281,7 @@ int wiringPiI2CWriteReg16 (int fd, int reg, int value)
 int wiringPiI2CSetupInterface (const char *device, int devId)
 {
   int fd ;
+  struct stat st ;
 
   if ((fd = open (device, O_RDWR)) < 0)
     return wiringPiFailure (WPI_ALMOST, "Unable to open I2C device: %s\n", strerror (errno)) ;
@@ -206,6 +289,9 @@ int wiringPiI2CSetupInterface (const char *device, int devId)
   if (ioctl (fd, I2C_SLAVE, devId) < 0)
     return wiringPiFailure (WPI_ALMOST, "Unable to select I2C device: %s\n", strerror (errno)) ;
 
+  if ((fd < MAX_I2C_FDS) && (fstat (fd, &st) == 0))
+    i2cBusForFd [fd] = WPI_BUS_I2C (minor (st.st_rdev)) + 1 ;
+
   return fd ;
 }
 
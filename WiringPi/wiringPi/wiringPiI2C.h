@@ -33,6 +33,10 @@ extern int wiringPiI2CReadReg16      (int fd, int reg) ;
 extern int wiringPiI2CWrite          (int fd, int data) ;
 extern int wiringPiI2CWriteReg8      (int fd, int reg, int data) ;
 extern int wiringPiI2CWriteReg16     (int fd, int reg, int data) ;
+extern int wiringPiI2CWriteBlock     (int fd, int reg, const unsigned char *values, int len) ;
+
+extern void wiringPiI2CLock          (int fd) ;
+extern void wiringPiI2CUnlock        (int fd) ;
 
 extern int wiringPiI2CSetupInterface (const char *device, int devId) ;
 extern int wiringPiI2CSetup          (const int devId) ;
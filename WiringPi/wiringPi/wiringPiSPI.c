@@ -31,6 +31,7 @@
 #include <linux/spi/spidev.h>
 
 #include "wiringPi.h"
+#include "wiringPiBus.h"
 
 #include "wiringPiSPI.h"
 
@@ -59,6 +60,24 @@ int wiringPiSPIGetFd (int channel)
 }
 
 
+/*
+ * wiringPiSPILock: wiringPiSPIUnlock:
+ *	Hold the SPI bus across several transfers. Both channels share
+ *	the one controller, so it's the same lock for either.
+ *********************************************************************************
+ */
+
+void wiringPiSPILock (int channel)
+{
+  wiringPiBusLock (WPI_BUS_SPI (0)) ;
+}
+
+void wiringPiSPIUnlock (int channel)
+{
+  wiringPiBusUnlock (WPI_BUS_SPI (0)) ;
+}
+
+
 /*
  * wiringPiSPIDataRW:
  *	Write and Read a block of data over the SPI bus.
@@ -71,6 +90,7 @@ int wiringPiSPIGetFd (int channel)
 int wiringPiSPIDataRW (int channel, unsigned char *data, int len)
 {
   struct spi_ioc_transfer spi ;
+  int result ;
 
   channel &= 1 ;
 
@@ -86,7 +106,11 @@ int wiringPiSPIDataRW (int channel, unsigned char *data, int len)
   spi.speed_hz      = spiSpeeds [channel] ;
   spi.bits_per_word = spiBPW ;
 
-  return ioctl (spiFds [channel], SPI_IOC_MESSAGE(1), &spi) ;
+  wiringPiSPILock (channel) ;
+    result = ioctl (spiFds [channel], SPI_IOC_MESSAGE(1), &spi) ;
+  wiringPiSPIUnlock (channel) ;
+
+  return result ;
 }
 
 
@@ -28,6 +28,8 @@ extern "C" {
 
 int wiringPiSPIGetFd     (int channel) ;
 int wiringPiSPIDataRW    (int channel, unsigned char *data, int len) ;
+void wiringPiSPILock     (int channel) ;
+void wiringPiSPIUnlock   (int channel) ;
 int wiringPiSPISetupMode (int channel, int speed, int mode) ;
 int wiringPiSPISetup     (int channel, int speed) ;
 
@@ -28,50 +28,271 @@
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
 
 #include "wiringSerial.h"
 
+#ifndef	TRUE
+#define	TRUE	(1==1)
+#define	FALSE	(1==2)
+#endif
+
+// Receive buffering
+//	Each port we read through gets a ring buffer so that we can pull in
+//	as much as the driver has with one read () and then hand it out a
+//	byte, a block or a line at a time.
+//	They're kept in a simple linked list - there are never many ports.
+
+#define	SERIAL_BUF_SIZE	4096		// Must be a power of 2
+
+struct serialBufStruct
+{
+  int          fd ;
+  unsigned int head ;			// Next byte in
+  unsigned int tail ;			// Next byte out
+  uint8_t      data [SERIAL_BUF_SIZE] ;
+
+  struct serialBufStruct *next ;
+} ;
+
+static struct serialBufStruct *serialBufs = NULL ;
+static pthread_mutex_t serialBufMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+
 /*
- * serialOpen:
- *	Open and initialise the serial port, setting all the right
- *	port parameters - or as many as are required - hopefully!
+ * findBuf:
+ *	Find the receive buffer for a port, optionally creating it
  *********************************************************************************
  */
 
-int serialOpen (const char *device, const int baud)
+static struct serialBufStruct *findBuf (const int fd, const int create)
 {
-  struct termios options ;
-  speed_t myBaud ;
-  int     status, fd ;
+  struct serialBufStruct *sb ;
+
+  pthread_mutex_lock (&serialBufMutex) ;
+
+  for (sb = serialBufs ; sb != NULL ; sb = sb->next)
+    if (sb->fd == fd)
+      break ;
+
+  if ((sb == NULL) && create)
+  {
+    if ((sb = (struct serialBufStruct *)calloc (1, sizeof (struct serialBufStruct))) != NULL)
+    {
+      sb->fd     = fd ;
+      sb->next   = serialBufs ;
+      serialBufs = sb ;
+    }
+  }
+
+  pthread_mutex_unlock (&serialBufMutex) ;
+
+  return sb ;
+}
+
+
+/*
+ * bufUsed: bufFill:
+ *	How much is waiting in the buffer, and top it up from the port with
+ *	a single read (). The read is into the contiguous free space only,
+ *	so we don't need a second syscall for the wrap.
+ *********************************************************************************
+ */
+
+static inline unsigned int bufUsed (struct serialBufStruct *sb)
+{
+  return sb->head - sb->tail ;
+}
+
+static int bufFill (struct serialBufStruct *sb)
+{
+  unsigned int offset, space ;
+  int got ;
+
+  offset = sb->head & (SERIAL_BUF_SIZE - 1) ;
+  space  = SERIAL_BUF_SIZE - bufUsed (sb) ;
+
+  if (space > SERIAL_BUF_SIZE - offset)
+    space = SERIAL_BUF_SIZE - offset ;
+
+  if (space == 0)
+    return 0 ;
+
+  if ((got = read (sb->fd, &sb->data [offset], space)) > 0)
+    sb->head += got ;
+
+  return got ;
+}
+
+
+/*
+ * waitReadable:
+ *	Wait up to mS milliseconds for data at the port.
+ *	0 is just a check, -1 is forever.
+ *********************************************************************************
+ */
+
+static int waitReadable (const int fd, const int mS)
+{
+  struct pollfd polls ;
+  int x ;
+
+  polls.fd     = fd ;
+  polls.events = POLLIN ;
+
+  while (((x = poll (&polls, 1, mS)) < 0) && (errno == EINTR))
+    ;
+
+  return x ;
+}
+
+
+/*
+ * remaining:
+ *	Milliseconds left until a deadline, for timeouts spanning several polls
+ *********************************************************************************
+ */
+
+static int remaining (const int timeoutMs, const struct timeval *start)
+{
+  struct timeval now, diff ;
+  long elapsed ;
+
+  if (timeoutMs < 0)
+    return -1 ;
+
+  gettimeofday (&now, NULL) ;
+  timersub (&now, start, &diff) ;
+  elapsed = diff.tv_sec * 1000 + diff.tv_usec / 1000 ;
+
+  return (elapsed >= timeoutMs) ? 0 : (int)(timeoutMs - elapsed) ;
+}
+
+
+/*
+ * Speeds:
+ *	The standard rates termios has a Bxxx code for. Anything else has to
+ *	be set as a raw number via termios2 and BOTHER.
+ *********************************************************************************
+ */
+
+static const struct { int baud ; speed_t speed ; } serialSpeeds [] =
+{
+  {      50,      B50 }, {      75,      B75 }, {     110,     B110 },
+  {     134,     B134 }, {     150,     B150 }, {     200,     B200 },
+  {     300,     B300 }, {     600,     B600 }, {    1200,    B1200 },
+  {    1800,    B1800 }, {    2400,    B2400 }, {    4800,    B4800 },
+  {    9600,    B9600 }, {   19200,   B19200 }, {   38400,   B38400 },
+  {   57600,   B57600 }, {  115200,  B115200 }, {  230400,  B230400 },
+#ifdef	B460800
+  {  460800,  B460800 }, {  500000,  B500000 }, {  576000,  B576000 },
+  {  921600,  B921600 }, { 1000000, B1000000 }, { 1152000, B1152000 },
+  { 1500000, B1500000 }, { 2000000, B2000000 }, { 2500000, B2500000 },
+  { 3000000, B3000000 }, { 3500000, B3500000 }, { 4000000, B4000000 },
+#endif
+  {       0,       B0 },
+} ;
+
+// termios2 - we can't include the kernel's termbits.h alongside
+//	<termios.h>, so here's our own copy of the structure.
+
+#ifndef	BOTHER
+#define	BOTHER	0010000
+#endif
+
+struct termios2
+{
+  tcflag_t c_iflag ;
+  tcflag_t c_oflag ;
+  tcflag_t c_cflag ;
+  tcflag_t c_lflag ;
+  cc_t     c_line ;
+  cc_t     c_cc [19] ;
+  speed_t  c_ispeed ;
+  speed_t  c_ospeed ;
+} ;
+
+
+/*
+ * setCustomBaud:
+ *	Set a non-standard baud rate on an open port
+ *********************************************************************************
+ */
+
+static int setCustomBaud (const int fd, const int baud)
+{
+#if	defined (TCGETS2) && defined (CBAUD)
+  struct termios2 tio ;
 
-  switch (baud)
+  if (ioctl (fd, TCGETS2, &tio) < 0)
+    return -1 ;
+
+  tio.c_cflag &= ~CBAUD ;
+  tio.c_cflag |= BOTHER ;
+  tio.c_ispeed = baud ;
+  tio.c_ospeed = baud ;
+
+  return ioctl (fd, TCSETS2, &tio) ;
+#else
+  return -1 ;
+#endif
+}
+
+
+/*
+ * serialOpenEx:
+ *	Open and initialise the serial port with full control over the line:
+ *	  baud:        Any rate - standard ones up to 4000000 directly,
+ *	               anything else via termios2 if the driver supports it
+ *	  dataBits:    5 through 8
+ *	  parity:      'N', 'E' or 'O'
+ *	  stopBits:    1 or 2
+ *	  flowControl: SERIAL_FLOW_NONE, SERIAL_FLOW_RTSCTS or SERIAL_FLOW_XONXOFF
+ *	Unlike serialOpen it leaves the DTR/RTS modem lines alone (unless
+ *	RTS/CTS flow control takes RTS over) and doesn't sleep afterwards.
+ *	Returns the fd, -1 if the device won't open or -2 for bad parameters.
+ *********************************************************************************
+ */
+
+int serialOpenEx (const char *device, const int baud, const int dataBits,
+	const int parity, const int stopBits, const int flowControl)
+{
+  struct termios options ;
+  speed_t myBaud = B0 ;
+  tcflag_t size ;
+  int     fd, i ;
+
+  for (i = 0 ; serialSpeeds [i].baud != 0 ; ++i)
+    if (serialSpeeds [i].baud == baud)
+    {
+      myBaud = serialSpeeds [i].speed ;
+      break ;
+    }
+
+  switch (dataBits)
   {
-    case     50:	myBaud =     B50 ; break ;
-    case     75:	myBaud =     B75 ; break ;
-    case    110:	myBaud =    B110 ; break ;
-    case    134:	myBaud =    B134 ; break ;
-    case    150:	myBaud =    B150 ; break ;
-    case    200:	myBaud =    B200 ; break ;
-    case    300:	myBaud =    B300 ; break ;
-    case    600:	myBaud =    B600 ; break ;
-    case   1200:	myBaud =   B1200 ; break ;
-    case   1800:	myBaud =   B1800 ; break ;
-    case   2400:	myBaud =   B2400 ; break ;
-    case   4800:	myBaud =   B4800 ; break ;
-    case   9600:	myBaud =   B9600 ; break ;
-    case  19200:	myBaud =  B19200 ; break ;
-    case  38400:	myBaud =  B38400 ; break ;
-    case  57600:	myBaud =  B57600 ; break ;
-    case 115200:	myBaud = B115200 ; break ;
-    case 230400:	myBaud = B230400 ; break ;
+    case 5:	size = CS5 ; break ;
+    case 6:	size = CS6 ; break ;
+    case 7:	size = CS7 ; break ;
+    case 8:	size = CS8 ; break ;
 
     default:
       return -2 ;
   }
 
+  if ((baud <= 0) || ((stopBits != 1) && (stopBits != 2)))
+    return -2 ;
+
+  if ((parity != 'N') && (parity != 'E') && (parity != 'O'))
+    return -2 ;
+
   if ((fd = open (device, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK)) == -1)
     return -1 ;
 
@@ -82,14 +303,27 @@ int serialOpen (const char *device, const int baud)
   tcgetattr (fd, &options) ;
 
     cfmakeraw   (&options) ;
-    cfsetispeed (&options, myBaud) ;
-    cfsetospeed (&options, myBaud) ;
+    cfsetispeed (&options, (myBaud == B0) ? B38400 : myBaud) ;
+    cfsetospeed (&options, (myBaud == B0) ? B38400 : myBaud) ;
 
     options.c_cflag |= (CLOCAL | CREAD) ;
-    options.c_cflag &= ~PARENB ;
-    options.c_cflag &= ~CSTOPB ;
-    options.c_cflag &= ~CSIZE ;
-    options.c_cflag |= CS8 ;
+    options.c_cflag &= ~(PARENB | PARODD | CSTOPB | CSIZE | CRTSCTS) ;
+    options.c_cflag |= size ;
+    options.c_iflag &= ~(IXON | IXOFF | IXANY) ;
+
+    /**/ if (parity == 'E')
+      options.c_cflag |= PARENB ;
+    else if (parity == 'O')
+      options.c_cflag |= PARENB | PARODD ;
+
+    if (stopBits == 2)
+      options.c_cflag |= CSTOPB ;
+
+    /**/ if (flowControl == SERIAL_FLOW_RTSCTS)
+      options.c_cflag |= CRTSCTS ;
+    else if (flowControl == SERIAL_FLOW_XONXOFF)
+      options.c_iflag |= IXON | IXOFF ;
+
     options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG) ;
     options.c_oflag &= ~OPOST ;
 
@@ -98,6 +332,33 @@ int serialOpen (const char *device, const int baud)
 
   tcsetattr (fd, TCSANOW | TCSAFLUSH, &options) ;
 
+  if (myBaud == B0)
+    if (setCustomBaud (fd, baud) < 0)
+    {
+      close (fd) ;
+      return -2 ;
+    }
+
+  return fd ;
+}
+
+
+/*
+ * serialOpen:
+ *	Open and initialise the serial port, setting all the right
+ *	port parameters - or as many as are required - hopefully!
+ *	This is the original 8N1 interface: it also raises DTR and RTS and
+ *	gives the other end 10mS to wake up.
+ *********************************************************************************
+ */
+
+int serialOpen (const char *device, const int baud)
+{
+  int status, fd ;
+
+  if ((fd = serialOpenEx (device, baud, 8, 'N', 1, SERIAL_FLOW_NONE)) < 0)
+    return fd ;
+
   ioctl (fd, TIOCMGET, &status);
 
   status |= TIOCM_DTR ;
@@ -119,7 +380,12 @@ int serialOpen (const char *device, const int baud)
 
 void serialFlush (const int fd)
 {
+  struct serialBufStruct *sb ;
+
   tcflush (fd, TCIOFLUSH) ;
+
+  if ((sb = findBuf (fd, FALSE)) != NULL)
+    sb->tail = sb->head ;
 }
 
 
@@ -131,6 +397,18 @@ void serialFlush (const int fd)
 
 void serialClose (const int fd)
 {
+  struct serialBufStruct *sb, **prev ;
+
+  pthread_mutex_lock (&serialBufMutex) ;
+    for (prev = &serialBufs ; (sb = *prev) != NULL ; prev = &sb->next)
+      if (sb->fd == fd)
+      {
+	*prev = sb->next ;
+	free (sb) ;
+	break ;
+      }
+  pthread_mutex_unlock (&serialBufMutex) ;
+
   close (fd) ;
 }
 
@@ -155,12 +433,53 @@ void serialPutchar (const int fd, const unsigned char c)
 
 void serialPuts (const int fd, const char *s)
 {
-  write (fd, s, strlen (s)) ;
+  serialWrite (fd, s, strlen (s)) ;
 }
 
+
+/*
+ * serialWrite:
+ *	Send a block of data to the serial port in as few write () calls as
+ *	the driver will let us. Returns the number of bytes sent, or -1.
+ *********************************************************************************
+ */
+
+int serialWrite (const int fd, const void *data, const int len)
+{
+  const uint8_t *p = (const uint8_t *)data ;
+  int sent = 0, x ;
+
+  while (sent < len)
+  {
+    if ((x = write (fd, p + sent, len - sent)) < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+
+      if (errno == EAGAIN)		// Port is non-blocking and full
+      {
+	struct pollfd polls ;
+
+	polls.fd     = fd ;
+	polls.events = POLLOUT ;
+	(void)poll (&polls, 1, -1) ;
+	continue ;
+      }
+
+      return (sent == 0) ? -1 : sent ;
+    }
+    sent += x ;
+  }
+
+  return sent ;
+}
+
+
 /*
  * serialPrintf:
  *	Printf over Serial
+ *	Output that won't fit in the buffer on the stack is formatted
+ *	into one on the heap instead, so there's no limit on the length.
  *********************************************************************************
  */
 
@@ -168,12 +487,31 @@ void serialPrintf (const int fd, const char *message, ...)
 {
   va_list argp ;
   char buffer [1024] ;
+  char *big ;
+  int  len ;
 
   va_start (argp, message) ;
-    vsnprintf (buffer, 1023, message, argp) ;
+    len = vsnprintf (buffer, sizeof (buffer), message, argp) ;
   va_end (argp) ;
 
-  serialPuts (fd, buffer) ;
+  if (len < 0)
+    return ;
+
+  if (len < (int)sizeof (buffer))
+  {
+    serialWrite (fd, buffer, len) ;
+    return ;
+  }
+
+  if ((big = malloc (len + 1)) == NULL)
+    return ;
+
+  va_start (argp, message) ;
+    vsnprintf (big, len + 1, message, argp) ;
+  va_end (argp) ;
+
+  serialWrite (fd, big, len) ;
+  free (big) ;
 }
 
 
@@ -185,11 +523,15 @@ void serialPrintf (const int fd, const char *message, ...)
 
 int serialDataAvail (const int fd)
 {
+  struct serialBufStruct *sb ;
   int result ;
 
   if (ioctl (fd, FIONREAD, &result) == -1)
     return -1 ;
 
+  if ((sb = findBuf (fd, FALSE)) != NULL)
+    result += bufUsed (sb) ;
+
   return result ;
 }
 
@@ -204,10 +546,469 @@ int serialDataAvail (const int fd)
 
 int serialGetchar (const int fd)
 {
+  struct serialBufStruct *sb ;
   uint8_t x ;
 
-  if (read (fd, &x, 1) != 1)
-    return -1 ;
+  if ((sb = findBuf (fd, TRUE)) == NULL)
+  {
+    if (read (fd, &x, 1) != 1)
+      return -1 ;
+
+    return ((int)x) & 0xFF ;
+  }
+
+  if (bufUsed (sb) == 0)
+    if (bufFill (sb) <= 0)
+      return -1 ;
+
+  x = sb->data [sb->tail++ & (SERIAL_BUF_SIZE - 1)] ;
 
   return ((int)x) & 0xFF ;
 }
+
+
+/*
+ * serialRead:
+ *	Read up to len bytes from the serial port, waiting at most
+ *	timeoutMs milliseconds (0 = don't wait, -1 = forever) for the first
+ *	of them to arrive. Returns the number of bytes read - which may be
+ *	less than asked for - 0 on timeout or -1 on error.
+ *********************************************************************************
+ */
+
+int serialRead (const int fd, void *data, const int len, const int timeoutMs)
+{
+  struct serialBufStruct *sb ;
+  uint8_t *p = (uint8_t *)data ;
+  unsigned int offset, chunk ;
+  int got = 0, x ;
+
+  if ((sb = findBuf (fd, TRUE)) == NULL)
+    return -1 ;
+
+  if (bufUsed (sb) == 0)
+  {
+    if ((x = waitReadable (fd, timeoutMs)) <= 0)
+      return x ;
+
+    if ((x = bufFill (sb)) <= 0)
+      return x ;
+  }
+
+// Copy out what we have, in at most two pieces for the wrap
+
+  while ((got < len) && (bufUsed (sb) != 0))
+  {
+    offset = sb->tail & (SERIAL_BUF_SIZE - 1) ;
+    chunk  = bufUsed (sb) ;
+
+    if (chunk > SERIAL_BUF_SIZE - offset)
+      chunk = SERIAL_BUF_SIZE - offset ;
+    if (chunk > (unsigned int)(len - got))
+      chunk = len - got ;
+
+    memcpy (p + got, &sb->data [offset], chunk) ;
+    sb->tail += chunk ;
+    got      += chunk ;
+  }
+
+  return got ;
+}
+
+
+/*
+ * serialReadLine:
+ *	Read a line - up to and including the delimiter - into buffer,
+ *	which is always zero terminated. We only scan what's already
+ *	buffered and top it up in blocks until the delimiter turns up,
+ *	the buffer is full or we run out of time.
+ *	Returns the length of the line (0 on timeout, -1 on error). A line
+ *	not yet terminated is left in the buffer on timeout.
+ *********************************************************************************
+ */
+
+int serialReadLine (const int fd, char *buffer, const int len, const int delim, const int timeoutMs)
+{
+  struct serialBufStruct *sb ;
+  struct timeval start ;
+  unsigned int scanned = 0, want, i ;
+  int x, found = FALSE ;
+
+  if (len < 1)
+    return -1 ;
+
+  if ((sb = findBuf (fd, TRUE)) == NULL)
+    return -1 ;
+
+  want = len - 1 ;
+  if (want > SERIAL_BUF_SIZE)
+    want = SERIAL_BUF_SIZE ;
+
+  gettimeofday (&start, NULL) ;
+
+  for (;;)
+  {
+    for ( ; (scanned < bufUsed (sb)) && (scanned < want) ; ++scanned)
+      if (sb->data [(sb->tail + scanned) & (SERIAL_BUF_SIZE - 1)] == (uint8_t)delim)
+      {
+	++scanned ;
+	found = TRUE ;
+	break ;
+      }
+
+    if (found || (scanned == want))
+      break ;
+
+    if ((x = waitReadable (fd, remaining (timeoutMs, &start))) < 0)
+      return -1 ;
+
+    if (x == 0)
+    {
+      buffer [0] = 0 ;
+      return 0 ;
+    }
+
+    if (bufFill (sb) <= 0)		// Readable but nothing there: hung up
+      return -1 ;
+  }
+
+  for (i = 0 ; i < scanned ; ++i)
+    buffer [i] = sb->data [sb->tail++ & (SERIAL_BUF_SIZE - 1)] ;
+  buffer [scanned] = 0 ;
+
+  return scanned ;
+}
+
+
+/*
+ * Serial watcher:
+ *	Rather than have every program sit polling serialDataAvail, one
+ *	thread waits on all the watched ports with epoll and calls back as
+ *	data arrives. Optionally it chops the stream into frames first -
+ *	either up to a delimiter, or fixed-length.
+ *********************************************************************************
+ */
+
+#define	SERIAL_FRAME_MAX	SERIAL_BUF_SIZE
+
+struct serialWatchStruct
+{
+  int    fd ;
+  void (*onData)(int fd, const unsigned char *data, int len, void *ctx) ;
+  void  *ctx ;
+
+  int    delim ;			// -1 for none
+  int    fixedLen ;			//  0 for none
+  int    dead ;				// Unwatched from inside its own callback
+
+  int           frameLen ;
+  unsigned char frame [SERIAL_FRAME_MAX] ;
+
+  struct serialWatchStruct *next ;
+} ;
+
+static struct serialWatchStruct *serialWatches = NULL ;
+static pthread_mutex_t serialWatchMutex ;
+static pthread_once_t  serialWatchOnce = PTHREAD_ONCE_INIT ;
+static pthread_t       serialWatchThread ;
+static int             serialEpollFd = -1 ;
+
+
+/*
+ * findWatch:
+ *	Locate a watch by fd. Call with serialWatchMutex held.
+ *********************************************************************************
+ */
+
+static struct serialWatchStruct *findWatch (const int fd)
+{
+  struct serialWatchStruct *w ;
+
+  for (w = serialWatches ; w != NULL ; w = w->next)
+    if (w->fd == fd)
+      return w ;
+
+  return NULL ;
+}
+
+
+/*
+ * deliver:
+ *	Pass a chunk of incoming data on, framing it as required
+ *********************************************************************************
+ */
+
+static void deliver (struct serialWatchStruct *w, const unsigned char *data, int len)
+{
+  int i, end ;
+
+  if ((w->delim < 0) && (w->fixedLen == 0))
+  {
+    w->onData (w->fd, data, len, w->ctx) ;
+    return ;
+  }
+
+  for (i = 0 ; (i < len) && !w->dead ; i = end)
+  {
+
+// Find the end of this frame in the new data - or take the lot
+
+    if (w->fixedLen != 0)
+    {
+      end = i + (w->fixedLen - w->frameLen) ;
+      if (end > len)
+	end = len ;
+    }
+    else
+    {
+      for (end = i ; end < len ; ++end)
+	if (data [end] == (unsigned char)w->delim)
+	{
+	  ++end ;
+	  break ;
+	}
+    }
+
+    if (end - i > SERIAL_FRAME_MAX - w->frameLen)	// Overlong - pass on what we have
+      end = i + (SERIAL_FRAME_MAX - w->frameLen) ;
+
+    memcpy (&w->frame [w->frameLen], &data [i], end - i) ;
+    w->frameLen += end - i ;
+
+    if ( (w->frameLen == SERIAL_FRAME_MAX) ||
+	((w->fixedLen != 0) && (w->frameLen == w->fixedLen)) ||
+	((w->fixedLen == 0) && (w->frame [w->frameLen - 1] == (unsigned char)w->delim)))
+    {
+      w->onData (w->fd, w->frame, w->frameLen, w->ctx) ;
+      w->frameLen = 0 ;
+    }
+  }
+}
+
+
+/*
+ * serialWatcher:
+ *	The thread that waits on all the ports.
+ *	We only ever read () what FIONREAD says is there - a tty with VTIME
+ *	set would otherwise sit in read () for the full timeout, holding
+ *	the lock, if something else drained it after epoll woke us. So no
+ *	data isn't the end of the stream; only a hang-up or error from
+ *	epoll (or the read) is.
+ *********************************************************************************
+ */
+
+static void *serialWatcher (void *arg)
+{
+  struct epoll_event events [16] ;
+  struct serialWatchStruct *w ;
+  struct serialBufStruct *sb ;
+  unsigned char chunk [SERIAL_BUF_SIZE] ;
+  int n, i, len, avail ;
+
+  for (;;)
+  {
+    if ((n = epoll_wait (serialEpollFd, events, 16, -1)) < 0)
+    {
+      if (errno == EINTR)
+	continue ;
+      break ;
+    }
+
+    for (i = 0 ; i < n ; ++i)
+    {
+      pthread_mutex_lock (&serialWatchMutex) ;
+
+      if ((w = findWatch (events [i].data.fd)) != NULL)
+      {
+
+// Anything left over in the receive buffer goes first
+
+	/**/ if (((sb = findBuf (w->fd, FALSE)) != NULL) && (bufUsed (sb) != 0))
+	  len = serialRead (w->fd, chunk, sizeof (chunk), 0) ;
+	else if (ioctl (w->fd, FIONREAD, &avail) < 0)
+	  len = -1 ;
+	else if (avail == 0)
+	  len = 0 ;
+	else
+	  len = read (w->fd, chunk, (avail < (int)sizeof (chunk)) ? avail : (int)sizeof (chunk)) ;
+
+	if (len > 0)
+	  deliver (w, chunk, len) ;
+	else if (((len == 0) && ((events [i].events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0)) ||
+		 ((len <  0) && (errno != EAGAIN) && (errno != EINTR)))		// Hung up
+	{
+	  w->onData (w->fd, NULL, len, w->ctx) ;
+	  if (!w->dead)
+	    serialUnwatch (w->fd) ;
+	}
+
+	if (w->dead)
+	  free (w) ;
+      }
+
+      pthread_mutex_unlock (&serialWatchMutex) ;
+    }
+  }
+
+  return NULL ;
+}
+
+
+/*
+ * serialWatchInit:
+ *	One-time creation of the epoll set and its thread
+ *********************************************************************************
+ */
+
+static void serialWatchInit (void)
+{
+  pthread_mutexattr_t attr ;
+
+// Recursive, so a callback can (un)watch ports
+
+  pthread_mutexattr_init    (&attr) ;
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE) ;
+  pthread_mutex_init        (&serialWatchMutex, &attr) ;
+
+  if ((serialEpollFd = epoll_create1 (EPOLL_CLOEXEC)) < 0)
+    return ;
+
+  if (pthread_create (&serialWatchThread, NULL, serialWatcher, NULL) != 0)
+  {
+    close (serialEpollFd) ;
+    serialEpollFd = -1 ;
+  }
+}
+
+
+/*
+ * serialWatch:
+ *	Have onData called, from the watcher thread, whenever data arrives
+ *	at the port. It's given the data, its length and your ctx pointer.
+ *	If the port hangs up it's called once more with NULL data and
+ *	the port is unwatched.
+ *	Calling it again for a port already watched just changes the callback.
+ *	Returns 0 on success, -1 on error.
+ *********************************************************************************
+ */
+
+int serialWatch (const int fd, void (*onData)(int fd, const unsigned char *data, int len, void *ctx), void *ctx)
+{
+  struct serialWatchStruct *w ;
+  struct epoll_event ev ;
+
+  pthread_once (&serialWatchOnce, serialWatchInit) ;
+
+  if ((serialEpollFd < 0) || (onData == NULL))
+    return -1 ;
+
+  pthread_mutex_lock (&serialWatchMutex) ;
+
+  if ((w = findWatch (fd)) == NULL)
+  {
+    if ((w = (struct serialWatchStruct *)calloc (1, sizeof (struct serialWatchStruct))) == NULL)
+    {
+      pthread_mutex_unlock (&serialWatchMutex) ;
+      return -1 ;
+    }
+
+    w->fd    = fd ;
+    w->delim = -1 ;
+
+    memset (&ev, 0, sizeof (ev)) ;
+    ev.events  = EPOLLIN | EPOLLRDHUP ;
+    ev.data.fd = fd ;
+
+    if (epoll_ctl (serialEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+      free (w) ;
+      pthread_mutex_unlock (&serialWatchMutex) ;
+      return -1 ;
+    }
+
+    w->next       = serialWatches ;
+    serialWatches = w ;
+  }
+
+  w->onData = onData ;
+  w->ctx    = ctx ;
+
+  pthread_mutex_unlock (&serialWatchMutex) ;
+
+  return 0 ;
+}
+
+
+/*
+ * serialWatchFraming:
+ *	Set how the data for a watched port is chopped up before it's
+ *	handed over: delim >= 0 gives frames ending in that character,
+ *	fixedLen > 0 gives frames of that many bytes. Both off (-1, 0)
+ *	passes on the data as it comes in.
+ *********************************************************************************
+ */
+
+int serialWatchFraming (const int fd, const int delim, const int fixedLen)
+{
+  struct serialWatchStruct *w ;
+
+  if ((fixedLen < 0) || (fixedLen > SERIAL_FRAME_MAX))
+    return -1 ;
+
+  pthread_once (&serialWatchOnce, serialWatchInit) ;
+
+  pthread_mutex_lock (&serialWatchMutex) ;
+
+  if ((w = findWatch (fd)) == NULL)
+  {
+    pthread_mutex_unlock (&serialWatchMutex) ;
+    return -1 ;
+  }
+
+  w->delim    = (fixedLen != 0) ? -1 : delim ;
+  w->fixedLen = fixedLen ;
+  w->frameLen = 0 ;
+
+  pthread_mutex_unlock (&serialWatchMutex) ;
+
+  return 0 ;
+}
+
+
+/*
+ * serialUnwatch:
+ *	Stop watching a port. Any partial frame is discarded.
+ *	Do this before closing the port.
+ *********************************************************************************
+ */
+
+int serialUnwatch (const int fd)
+{
+  struct serialWatchStruct *w, **prev ;
+
+  pthread_once (&serialWatchOnce, serialWatchInit) ;
+
+  pthread_mutex_lock (&serialWatchMutex) ;
+
+  for (prev = &serialWatches ; (w = *prev) != NULL ; prev = &w->next)
+    if (w->fd == fd)
+      break ;
+
+  if (w == NULL)
+  {
+    pthread_mutex_unlock (&serialWatchMutex) ;
+    return -1 ;
+  }
+
+  *prev = w->next ;
+  epoll_ctl (serialEpollFd, EPOLL_CTL_DEL, fd, NULL) ;
+
+  if (pthread_equal (pthread_self (), serialWatchThread))	// In a callback - the watcher frees it
+    w->dead = TRUE ;
+  else
+    free (w) ;
+
+  pthread_mutex_unlock (&serialWatchMutex) ;
+
+  return 0 ;
+}
@@ -20,11 +20,19 @@
  ***********************************************************************
  */
 
+// Flow control for serialOpenEx
+
+#define	SERIAL_FLOW_NONE	0
+#define	SERIAL_FLOW_RTSCTS	1
+#define	SERIAL_FLOW_XONXOFF	2
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern int   serialOpen      (const char *device, const int baud) ;
+extern int   serialOpenEx    (const char *device, const int baud, const int dataBits,
+			      const int parity, const int stopBits, const int flowControl) ;
 extern void  serialClose     (const int fd) ;
 extern void  serialFlush     (const int fd) ;
 extern void  serialPutchar   (const int fd, const unsigned char c) ;
@@ -33,6 +41,14 @@ extern void  serialPrintf    (const int fd, const char *message, ...) ;
 extern int   serialDataAvail (const int fd) ;
 extern int   serialGetchar   (const int fd) ;
 
+extern int   serialWrite     (const int fd, const void *data, const int len) ;
+extern int   serialRead      (const int fd, void *data, const int len, const int timeoutMs) ;
+extern int   serialReadLine  (const int fd, char *buffer, const int len, const int delim, const int timeoutMs) ;
+
+extern int   serialWatch        (const int fd, void (*onData)(int fd, const unsigned char *data, int len, void *ctx), void *ctx) ;
+extern int   serialWatchFraming (const int fd, const int delim, const int fixedLen) ;
+extern int   serialUnwatch      (const int fd) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
  */
 
 #include <stdint.h>
+#include <time.h>
 
 #include "wiringPi.h"
 #include "wiringShift.h"
@@ -81,3 +82,189 @@ void shiftOut (uint8_t dPin, uint8_t cPin, uint8_t order, uint8_t val)
       digitalWrite (cPin, LOW) ;
     }
 }
+
+
+/*
+ * Buffered shifting:
+ *	For on-board pins we look up the GPIO registers once and write them
+ *	directly, pacing the edges with a spin loop calibrated against the
+ *	system clock. That's fast enough for long 74x595 chains and LED
+ *	strips to go at several MHz. Anything else (or if we can't work out
+ *	the registers) falls back to digitalWrite/digitalRead.
+ *	A clockHz of 0 means as fast as possible.
+ *********************************************************************************
+ */
+
+static unsigned int spinsPerMs = 0 ;
+
+static void spin (unsigned int count)
+{
+  volatile unsigned int i ;
+
+  for (i = 0 ; i < count ; ++i)
+    ;
+}
+
+
+/*
+ * calibrate:
+ *	Time a millisecond or so of the spin loop, once. We take the best of
+ *	a few tries so that being scheduled out doesn't skew it.
+ *********************************************************************************
+ */
+
+static void calibrate (void)
+{
+  struct timespec start, end ;
+  unsigned int count = 100000, best = 0, perMs ;
+  long long ns ;
+  int tries ;
+
+  for (tries = 0 ; tries < 5 ; ++tries)
+  {
+    clock_gettime (CLOCK_MONOTONIC, &start) ;
+    spin (count) ;
+    clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+    ns = (long long)(end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec) ;
+    if (ns <= 0)
+      ns = 1 ;
+
+    perMs = (unsigned int)((long long)count * 1000000LL / ns) ;
+    if (perMs > best)
+      best = perMs ;
+  }
+
+  spinsPerMs = (best == 0) ? 1 : best ;
+}
+
+
+/*
+ * halfPeriod:
+ *	Work out the spin count for half a clock cycle. Returns 0 for none.
+ *********************************************************************************
+ */
+
+static unsigned int halfPeriod (int clockHz)
+{
+  if (clockHz <= 0)
+    return 0 ;
+
+  if (spinsPerMs == 0)
+    calibrate () ;
+
+  return (unsigned int)((unsigned long long)spinsPerMs * 500 / clockHz) ;
+}
+
+
+/*
+ * shiftOutBuf:
+ *	Shift len bytes out of buf, first byte first, with the given bit
+ *	order within each byte.
+ *********************************************************************************
+ */
+
+void shiftOutBuf (int dPin, int cPin, uint8_t order, const uint8_t *buf, int len, int clockHz)
+{
+  struct wpiPinRegs data, clock ;
+  unsigned int half = halfPeriod (clockHz) ;
+  int halfUs = (clockHz > 0) ? 500000 / clockHz : 0 ;
+  int i, bit, n ;
+  uint8_t val ;
+
+  if (wiringPiPinRegs (dPin, &data) && wiringPiPinRegs (cPin, &clock))
+  {
+    for (n = 0 ; n < len ; ++n)
+    {
+      val = buf [n] ;
+      for (i = 0 ; i < 8 ; ++i)
+      {
+	bit = (order == MSBFIRST) ? (val & (0x80 >> i)) : (val & (1 << i)) ;
+
+	if (bit)
+	  *data.set = data.mask ;
+	else
+	  *data.clr = data.mask ;
+	spin (half) ;
+	*clock.set = clock.mask ;
+	spin (half) ;
+	*clock.clr = clock.mask ;
+      }
+    }
+    return ;
+  }
+
+  for (n = 0 ; n < len ; ++n)
+  {
+    val = buf [n] ;
+    for (i = 0 ; i < 8 ; ++i)
+    {
+      bit = (order == MSBFIRST) ? (val & (0x80 >> i)) : (val & (1 << i)) ;
+
+      digitalWrite (dPin, bit) ;
+      if (halfUs > 0) delayMicroseconds (halfUs) ;
+      digitalWrite (cPin, HIGH) ;
+      if (halfUs > 0) delayMicroseconds (halfUs) ;
+      digitalWrite (cPin, LOW) ;
+    }
+  }
+}
+
+
+/*
+ * shiftInBuf:
+ *	Shift len bytes into buf. As with shiftIn, the data is sampled
+ *	while the clock is high.
+ *********************************************************************************
+ */
+
+void shiftInBuf (int dPin, int cPin, uint8_t order, uint8_t *buf, int len, int clockHz)
+{
+  struct wpiPinRegs data, clock ;
+  unsigned int half = halfPeriod (clockHz) ;
+  int halfUs = (clockHz > 0) ? 500000 / clockHz : 0 ;
+  int i, n, bit ;
+  uint8_t val ;
+
+  if (wiringPiPinRegs (dPin, &data) && wiringPiPinRegs (cPin, &clock))
+  {
+    for (n = 0 ; n < len ; ++n)
+    {
+      val = 0 ;
+      for (i = 0 ; i < 8 ; ++i)
+      {
+	*clock.set = clock.mask ;
+	spin (half) ;
+	bit = (*data.lev & data.mask) != 0 ;
+	*clock.clr = clock.mask ;
+	spin (half) ;
+
+	if (order == MSBFIRST)
+	  val = (val << 1) | bit ;
+	else
+	  val |= bit << i ;
+      }
+      buf [n] = val ;
+    }
+    return ;
+  }
+
+  for (n = 0 ; n < len ; ++n)
+  {
+    val = 0 ;
+    for (i = 0 ; i < 8 ; ++i)
+    {
+      digitalWrite (cPin, HIGH) ;
+      if (halfUs > 0) delayMicroseconds (halfUs) ;
+      bit = digitalRead (dPin) ;
+      digitalWrite (cPin, LOW) ;
+      if (halfUs > 0) delayMicroseconds (halfUs) ;
+
+      if (order == MSBFIRST)
+	val = (val << 1) | bit ;
+      else
+	val |= bit << i ;
+    }
+    buf [n] = val ;
+  }
+}
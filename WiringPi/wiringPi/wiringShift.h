@@ -36,6 +36,9 @@ extern "C" {
 extern uint8_t shiftIn      (uint8_t dPin, uint8_t cPin, uint8_t order) ;
 extern void    shiftOut     (uint8_t dPin, uint8_t cPin, uint8_t order, uint8_t val) ;
 
+extern void    shiftInBuf   (int dPin, int cPin, uint8_t order,       uint8_t *buf, int len, int clockHz) ;
+extern void    shiftOutBuf  (int dPin, int cPin, uint8_t order, const uint8_t *buf, int len, int clockHz) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,6 +54,8 @@ extern int  wiringPiSetup       (void) ;
 extern int  wiringPiSetupSys    (void) ;
 extern int  wiringPiSetupGpio   (void) ;
 extern int  wiringPiSetupPhys   (void) ;
+extern int  wiringPiSetupGpioChip (void) ;
+extern void wiringPiTeardown    (void) ;
 
 extern void pinModeAlt          (int pin, int mode) ;
 extern void pinMode             (int pin, int mode) ;
@@ -81,6 +83,7 @@ extern void gpioClockSet        (int pin, int freq) ;
 // Interrupts
 extern int  waitForInterrupt    (int pin, int mS) ;
 extern int  wiringPiISR         (int pin, int mode, void (*function)(void)) ;
+extern int  wiringPiGpioChipEdge (int pin, int edgeType) ;
 
 // Threads
 extern int  piThreadCreate      (void *(*fn)(void *)) ;
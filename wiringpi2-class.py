@@ -50,6 +50,7 @@ class GPIO(object):
   WPI_MODE_GPIO_SYS = 2
   WPI_MODE_PHYS = 3
   WPI_MODE_PIFACE = 4
+  WPI_MODE_GPIO_CHIP = 5
   WPI_MODE_UNINITIALISED = -1
 
   INPUT = 0
@@ -88,6 +89,8 @@ class GPIO(object):
       wiringPiSetupPhys()
     if pinmode==self.WPI_MODE_PIFACE:
       wiringPiSetupPiFace()
+    if pinmode==self.WPI_MODE_GPIO_CHIP:
+      wiringPiSetupGpioChip()
 
   def delay(self,*args):
     delay(*args)
@@ -150,6 +153,8 @@ class GPIO(object):
     return waitForInterrupt(*args)
   def wiringPiISR(self,*args):
     return wiringPiISR(*args)
+  def wiringPiGpioChipEdge(self,*args):
+    return wiringPiGpioChipEdge(*args)
 
   def softPwmCreate(self,*args):
     return softPwmCreate(*args)
@@ -96,6 +96,14 @@ def wiringPiSetupPhys():
   return _wiringpi2.wiringPiSetupPhys()
 wiringPiSetupPhys = _wiringpi2.wiringPiSetupPhys
 
+def wiringPiSetupGpioChip():
+  return _wiringpi2.wiringPiSetupGpioChip()
+wiringPiSetupGpioChip = _wiringpi2.wiringPiSetupGpioChip
+
+def wiringPiTeardown():
+  return _wiringpi2.wiringPiTeardown()
+wiringPiTeardown = _wiringpi2.wiringPiTeardown
+
 def pinModeAlt(*args):
   return _wiringpi2.pinModeAlt(*args)
 pinModeAlt = _wiringpi2.pinModeAlt
@@ -184,6 +192,10 @@ def wiringPiISR(*args):
   return _wiringpi2.wiringPiISR(*args)
 wiringPiISR = _wiringpi2.wiringPiISR
 
+def wiringPiGpioChipEdge(*args):
+  return _wiringpi2.wiringPiGpioChipEdge(*args)
+wiringPiGpioChipEdge = _wiringpi2.wiringPiGpioChipEdge
+
 def piThreadCreate(*args):
   return _wiringpi2.piThreadCreate(*args)
 piThreadCreate = _wiringpi2.piThreadCreate
@@ -630,6 +642,7 @@ class GPIO(object):
   WPI_MODE_GPIO_SYS = 2
   WPI_MODE_PHYS = 3
   WPI_MODE_PIFACE = 4
+  WPI_MODE_GPIO_CHIP = 5
   WPI_MODE_UNINITIALISED = -1
 
   INPUT = 0
@@ -668,6 +681,8 @@ class GPIO(object):
       wiringPiSetupPhys()
     if pinmode==self.WPI_MODE_PIFACE:
       wiringPiSetupPiFace()
+    if pinmode==self.WPI_MODE_GPIO_CHIP:
+      wiringPiSetupGpioChip()
 
   def delay(self,*args):
     delay(*args)
@@ -730,6 +745,8 @@ class GPIO(object):
     return waitForInterrupt(*args)
   def wiringPiISR(self,*args):
     return wiringPiISR(*args)
+  def wiringPiGpioChipEdge(self,*args):
+    return wiringPiGpioChipEdge(*args)
 
   def softPwmCreate(self,*args):
     return softPwmCreate(*args)
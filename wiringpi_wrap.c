@@ -3506,6 +3506,31 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_wiringPiSetupGpioChip(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
+  PyObject *resultobj = 0;
+  int result;
+  
+  if (!PyArg_ParseTuple(args,(char *)":wiringPiSetupGpioChip")) SWIG_fail;
+  result = (int)wiringPiSetupGpioChip();
+  resultobj = SWIG_From_int((int)(result));
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_wiringPiTeardown(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
+  PyObject *resultobj = 0;
+  
+  if (!PyArg_ParseTuple(args,(char *)":wiringPiTeardown")) SWIG_fail;
+  wiringPiTeardown();
+  resultobj = SWIG_Py_Void();
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_pinModeAlt(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
   PyObject *resultobj = 0;
   int arg1 ;
@@ -4110,6 +4135,37 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_wiringPiGpioChipEdge(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
+  PyObject *resultobj = 0;
+  int arg1 ;
+  int arg2 ;
+  int val1 ;
+  int ecode1 = 0 ;
+  int val2 ;
+  int ecode2 = 0 ;
+  PyObject * obj0 = 0 ;
+  PyObject * obj1 = 0 ;
+  int result;
+  
+  if (!PyArg_ParseTuple(args,(char *)"OO:wiringPiGpioChipEdge",&obj0,&obj1)) SWIG_fail;
+  ecode1 = SWIG_AsVal_int(obj0, &val1);
+  if (!SWIG_IsOK(ecode1)) {
+    SWIG_exception_fail(SWIG_ArgError(ecode1), "in method '" "wiringPiGpioChipEdge" "', argument " "1"" of type '" "int""'");
+  } 
+  arg1 = (int)(val1);
+  ecode2 = SWIG_AsVal_int(obj1, &val2);
+  if (!SWIG_IsOK(ecode2)) {
+    SWIG_exception_fail(SWIG_ArgError(ecode2), "in method '" "wiringPiGpioChipEdge" "', argument " "2"" of type '" "int""'");
+  } 
+  arg2 = (int)(val2);
+  result = (int)wiringPiGpioChipEdge(arg1,arg2);
+  resultobj = SWIG_From_int((int)(result));
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_piThreadCreate(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
   PyObject *resultobj = 0;
   void *(*arg1)(void *) = (void *(*)(void *)) 0 ;
@@ -7359,6 +7415,8 @@ static PyMethodDef SwigMethods[] = {
 	 { (char *)"wiringPiSetupSys", _wrap_wiringPiSetupSys, METH_VARARGS, NULL},
 	 { (char *)"wiringPiSetupGpio", _wrap_wiringPiSetupGpio, METH_VARARGS, NULL},
 	 { (char *)"wiringPiSetupPhys", _wrap_wiringPiSetupPhys, METH_VARARGS, NULL},
+	 { (char *)"wiringPiSetupGpioChip", _wrap_wiringPiSetupGpioChip, METH_VARARGS, NULL},
+	 { (char *)"wiringPiTeardown", _wrap_wiringPiTeardown, METH_VARARGS, NULL},
 	 { (char *)"pinModeAlt", _wrap_pinModeAlt, METH_VARARGS, NULL},
 	 { (char *)"pinMode", _wrap_pinMode, METH_VARARGS, NULL},
 	 { (char *)"pullUpDnControl", _wrap_pullUpDnControl, METH_VARARGS, NULL},
@@ -7381,6 +7439,7 @@ static PyMethodDef SwigMethods[] = {
 	 { (char *)"gpioClockSet", _wrap_gpioClockSet, METH_VARARGS, NULL},
 	 { (char *)"waitForInterrupt", _wrap_waitForInterrupt, METH_VARARGS, NULL},
 	 { (char *)"wiringPiISR", _wrap_wiringPiISR, METH_VARARGS, NULL},
+	 { (char *)"wiringPiGpioChipEdge", _wrap_wiringPiGpioChipEdge, METH_VARARGS, NULL},
 	 { (char *)"piThreadCreate", _wrap_piThreadCreate, METH_VARARGS, NULL},
 	 { (char *)"piLock", _wrap_piLock, METH_VARARGS, NULL},
 	 { (char *)"piUnlock", _wrap_piUnlock, METH_VARARGS, NULL},